@@ -0,0 +1,172 @@
+// bench.h
+// 基准测试的公共工具：计时、延迟样本、随机数、JSON 输出
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#include "XShare.h"
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline void bench_sleep(double seconds) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    while (nanosleep(&ts, &ts) != 0) {}
+}
+
+// 创建加载了标准库和 xshare 的 Lua 状态
+static inline lua_State* bench_new_state(void) {
+    lua_State* L = luaL_newstate();
+    if (!L) return NULL;
+    luaL_openlibs(L);
+    luaL_requiref(L, "xshare", luaopen_XShare, 1);
+    lua_pop(L, 1);
+    return L;
+}
+
+// 加载一段 Lua 代码并执行，返回值留在栈上；失败时打印错误并退出
+static inline void bench_run_chunk(lua_State* L, const char* code, const char* name, int nargs, int nresults) {
+    if (luaL_loadbuffer(L, code, strlen(code), name) != LUA_OK) {
+        fprintf(stderr, "%s: %s\n", name, lua_tostring(L, -1));
+        exit(1);
+    }
+    if (nargs > 0) lua_insert(L, -nargs - 1);
+    if (lua_pcall(L, nargs, nresults, 0) != LUA_OK) {
+        fprintf(stderr, "%s: %s\n", name, lua_tostring(L, -1));
+        exit(1);
+    }
+}
+
+// 完整收集并立即清除（与 xshare.gc.collect() 相同）
+static inline void bench_full_collect(GC* gc) {
+    pthread_rwlock_wrlock(&gc->rwlock);
+    gc_collect(gc);
+    gc_sweep(gc, 1);
+    pthread_rwlock_unlock(&gc->rwlock);
+}
+
+// ---------- 延迟样本 ----------
+
+typedef struct BenchSamples {
+    uint64_t* data;   // 纳秒
+    size_t count;
+    size_t cap;
+} BenchSamples;
+
+static inline void bench_samples_add(BenchSamples* s, uint64_t ns) {
+    if (s->count == s->cap) {
+        size_t newcap = s->cap ? s->cap * 2 : 1024;
+        uint64_t* p = (uint64_t*)realloc(s->data, newcap * sizeof(uint64_t));
+        if (!p) return;   // 内存不足时丢弃样本，不影响吞吐统计
+        s->data = p;
+        s->cap = newcap;
+    }
+    s->data[s->count++] = ns;
+}
+
+static inline void bench_samples_merge(BenchSamples* dst, const BenchSamples* src) {
+    for (size_t i = 0; i < src->count; i++)
+        bench_samples_add(dst, src->data[i]);
+}
+
+static inline void bench_samples_free(BenchSamples* s) {
+    free(s->data);
+    s->data = NULL;
+    s->count = s->cap = 0;
+}
+
+static inline int bench_cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// 排序后取分位数（p 取 0~1）；调用前需 bench_samples_sort
+static inline void bench_samples_sort(BenchSamples* s) {
+    qsort(s->data, s->count, sizeof(uint64_t), bench_cmp_u64);
+}
+
+static inline uint64_t bench_percentile(const BenchSamples* s, double p) {
+    if (s->count == 0) return 0;
+    size_t i = (size_t)(p * (double)(s->count - 1) + 0.5);
+    return s->data[i];
+}
+
+// 输出 "latency_ns":{...}
+static inline void bench_json_latency(FILE* out, BenchSamples* s) {
+    bench_samples_sort(s);
+    fprintf(out, "\"latency_ns\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+            (unsigned long long)bench_percentile(s, 0.50),
+            (unsigned long long)bench_percentile(s, 0.90),
+            (unsigned long long)bench_percentile(s, 0.99),
+            (unsigned long long)bench_percentile(s, 1.0));
+}
+
+// ---------- 随机数 ----------
+
+// xorshift64*，每个线程一个状态
+static inline uint64_t bench_rand(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline double bench_rand_unit(uint64_t* state) {
+    return (double)(bench_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Zipf 分布的累积分布表，n 个元素，指数 s
+static inline double* bench_zipf_cdf(size_t n, double s) {
+    double* cdf = (double*)malloc(n * sizeof(double));
+    if (!cdf) return NULL;
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += 1.0 / pow((double)(i + 1), s);
+        cdf[i] = sum;
+    }
+    for (size_t i = 0; i < n; i++)
+        cdf[i] /= sum;
+    return cdf;
+}
+
+// 按累积分布表采样，返回 [0, n)
+static inline size_t bench_zipf_sample(const double* cdf, size_t n, uint64_t* state) {
+    double u = bench_rand_unit(state);
+    size_t lo = 0, hi = n - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// 解析逗号分隔的整数列表，返回个数
+static inline int bench_parse_ints(const char* s, int* out, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        char* end;
+        long v = strtol(s, &end, 10);
+        if (end == s) break;
+        if (v > 0) out[n++] = (int)v;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+#endif
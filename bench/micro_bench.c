@@ -0,0 +1,355 @@
+// micro_bench.c
+// 序列化与 GC 微基准：
+//   roundtrip.<形态>.create/push  每种 Lua 值形态的 stored_create / stored_push 耗时
+//   gc.pause.live_<N>             存活 N 个对象时一次完整收集的停顿
+//   alloc.threads_<N>             N 个线程并发创建对象的总速率
+// 结果以 JSON 输出，每个指标单独一行。指定 --baseline 时与保存的结果比较，
+// 任一指标比基线差超过 --threshold（百分比）即以退出码 1 失败。
+//
+// 用法：xshare_microbench [--duration 秒] [--live 1000,10000,100000] [--threads 1,2,4]
+//                         [--out 文件] [--baseline 文件] [--threshold 10]
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define MAX_LIST 32
+#define MIN_ITERATIONS 10
+#define PAUSE_REPEAT 5
+
+// 值形态：代码返回一个值
+typedef struct Shape {
+    const char* name;
+    const char* code;
+} Shape;
+
+static const Shape SHAPES[] = {
+    {"flat_array",
+     "local t = {}\n"
+     "for i = 1, 1000 do t[i] = i end\n"
+     "return t\n"},
+    {"nested_map",
+     "local function build(d)\n"
+     "  local t = {}\n"
+     "  for i = 1, 8 do t['k' .. i] = d > 0 and build(d - 1) or i end\n"
+     "  return t\n"
+     "end\n"
+     "return build(3)\n"},
+    {"closure",
+     "local a, b, c = 1, 'upvalue', {1, 2, 3}\n"
+     "return function(x)\n"
+     "  local s = a + x\n"
+     "  for i = 1, #c do s = s + c[i] end\n"
+     "  return s, b\n"
+     "end\n"},
+    {"string_1mb",
+     "return string.rep('x', 1024 * 1024)\n"},
+};
+#define SHAPE_COUNT (sizeof(SHAPES) / sizeof(SHAPES[0]))
+
+// ---------- 结果 ----------
+
+typedef struct Metric {
+    char name[64];
+    const char* unit;
+    int higherIsBetter;
+    double value;
+} Metric;
+
+static Metric metrics[256];
+static int metricCount = 0;
+
+static void emit(FILE* out, const char* name, const char* unit, int higherIsBetter, double value, const char* extra) {
+    if (metricCount < (int)(sizeof(metrics) / sizeof(metrics[0]))) {
+        Metric* m = &metrics[metricCount];
+        snprintf(m->name, sizeof(m->name), "%s", name);
+        m->unit = unit;
+        m->higherIsBetter = higherIsBetter;
+        m->value = value;
+    }
+    fprintf(out, "%s\n    {\"name\":\"%s\",\"unit\":\"%s\",\"better\":\"%s\",\"value\":%.1f%s%s}",
+            metricCount ? "," : "", name, unit, higherIsBetter ? "higher" : "lower", value,
+            extra ? "," : "", extra ? extra : "");
+    fflush(out);
+    metricCount++;
+}
+
+// ---------- 往返 ----------
+
+static void bench_roundtrip(lua_State* L, const Shape* shape, double duration, FILE* out) {
+    bench_run_chunk(L, shape->code, shape->name, 0, 1);
+    int idx = lua_gettop(L);
+    BenchSamples create = {0}, push = {0};
+    uint64_t end = bench_now_ns() + (uint64_t)(duration * 1e9);
+    for (int i = 0; i < MIN_ITERATIONS || bench_now_ns() < end; i++) {
+        uint64_t t0 = bench_now_ns();
+        StoredObject* obj = stored_create(L, idx);
+        uint64_t t1 = bench_now_ns();
+        stored_push(L, obj);
+        uint64_t t2 = bench_now_ns();
+        lua_pop(L, 1);
+        gc_release((GCObject*)obj);
+        bench_samples_add(&create, t1 - t0);
+        bench_samples_add(&push, t2 - t1);
+    }
+    lua_pop(L, 1);
+
+    char name[64], extra[128];
+    BenchSamples* parts[2] = {&create, &push};
+    const char* partNames[2] = {"create", "push"};
+    for (int p = 0; p < 2; p++) {
+        bench_samples_sort(parts[p]);
+        snprintf(name, sizeof(name), "roundtrip.%s.%s", shape->name, partNames[p]);
+        snprintf(extra, sizeof(extra), "\"p99\":%llu,\"iterations\":%zu",
+                 (unsigned long long)bench_percentile(parts[p], 0.99), parts[p]->count);
+        emit(out, name, "ns", 0, (double)bench_percentile(parts[p], 0.5), extra);
+        bench_samples_free(parts[p]);
+    }
+}
+
+// ---------- 收集停顿 ----------
+
+// 在独立堆中建立一个有 live/2 个键值对的共享表，测量完整收集的停顿（中位数）
+static void bench_pause(lua_State* L, size_t live, FILE* out) {
+    GC* gc = gc_new();
+    if (!gc) {
+        fprintf(stderr, "cannot create heap\n");
+        exit(1);
+    }
+    gc_pause(gc);
+    SharedTable* st = shared_table_create(gc);
+    for (size_t i = 1; i <= live / 2; i++) {
+        lua_pushinteger(L, (lua_Integer)i);
+        StoredObject* key = stored_create_ex(L, -1, gc);
+        StoredObject* val = stored_create_ex(L, -1, gc);   // 键和值各是一个对象
+        lua_pop(L, 1);
+        shared_table_set(st, key, val);
+        gc_release((GCObject*)key);
+        gc_release((GCObject*)val);
+    }
+    gc_resume(gc);
+
+    BenchSamples pause = {0};
+    for (int i = 0; i < PAUSE_REPEAT; i++) {
+        pthread_rwlock_wrlock(&gc->rwlock);
+        uint64_t t0 = bench_now_ns();
+        gc_collect(gc);
+        uint64_t t1 = bench_now_ns();
+        gc_sweep(gc, 1);
+        pthread_rwlock_unlock(&gc->rwlock);
+        bench_samples_add(&pause, t1 - t0);
+    }
+    bench_samples_sort(&pause);
+
+    char name[64], extra[64];
+    snprintf(name, sizeof(name), "gc.pause.live_%zu", live);
+    snprintf(extra, sizeof(extra), "\"objects\":%d", gc_count(gc));
+    emit(out, name, "ns", 0, (double)bench_percentile(&pause, 0.5), extra);
+    bench_samples_free(&pause);
+
+    // 释放表和堆句柄：堆中已没有外部引用的对象，由 gc_heap_release 的回收线程收集后销毁堆
+    gc_release((GCObject*)st);
+    gc_heap_release(gc);
+}
+
+// ---------- 并发分配 ----------
+
+typedef struct AllocRun {
+    atomic_int stop;
+    atomic_int started;
+} AllocRun;
+
+typedef struct AllocWorker {
+    pthread_t thread;
+    AllocRun* run;
+    uint64_t ops;
+} AllocWorker;
+
+static void* alloc_main(void* arg) {
+    AllocWorker* w = (AllocWorker*)arg;
+    lua_State* L = bench_new_state();
+    if (!L) {
+        fprintf(stderr, "cannot create lua state\n");
+        exit(1);
+    }
+    lua_pushliteral(L, "a short shared string");
+    atomic_fetch_add(&w->run->started, 1);
+    while (!atomic_load_explicit(&w->run->stop, memory_order_relaxed)) {
+        StoredObject* obj = stored_create(L, -1);
+        gc_release((GCObject*)obj);
+        w->ops++;
+    }
+    lua_close(L);
+    return NULL;
+}
+
+static void bench_alloc(int threads, double duration, FILE* out) {
+    AllocRun run;
+    atomic_init(&run.stop, 0);
+    atomic_init(&run.started, 0);
+    AllocWorker* workers = (AllocWorker*)calloc((size_t)threads, sizeof(AllocWorker));
+    if (!workers) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < threads; i++) {
+        workers[i].run = &run;
+        if (pthread_create(&workers[i].thread, NULL, alloc_main, &workers[i]) != 0) {
+            fprintf(stderr, "cannot create thread\n");
+            exit(1);
+        }
+    }
+    while (atomic_load(&run.started) < threads)
+        bench_sleep(0.001);
+    uint64_t start = bench_now_ns();
+    bench_sleep(duration);
+    atomic_store(&run.stop, 1);
+    uint64_t ops = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        ops += workers[i].ops;
+    }
+    double elapsed = (double)(bench_now_ns() - start) / 1e9;
+    free(workers);
+
+    char name[64];
+    snprintf(name, sizeof(name), "alloc.threads_%d", threads);
+    emit(out, name, "ops/s", 1, (double)ops / elapsed, NULL);
+    bench_full_collect(gc_instance());
+}
+
+// ---------- 基线比较 ----------
+
+// 从基线文件中查找指标值；基线为本程序的输出，每个指标一行
+static int baseline_lookup(const char* text, const char* name, double* value) {
+    char pat[96];
+    snprintf(pat, sizeof(pat), "\"name\":\"%s\"", name);
+    const char* p = strstr(text, pat);
+    if (!p) return 0;
+    const char* eol = strchr(p, '\n');
+    const char* v = strstr(p, "\"value\":");
+    if (!v || (eol && v > eol)) return 0;
+    *value = strtod(v + 8, NULL);
+    return 1;
+}
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* buf = len >= 0 ? (char*)malloc((size_t)len + 1) : NULL;
+    if (buf) {
+        size_t n = fread(buf, 1, (size_t)len, f);
+        buf[n] = '\0';
+    }
+    fclose(f);
+    return buf;
+}
+
+// 返回退化的指标数
+static int compare_baseline(const char* path, double threshold) {
+    char* text = read_file(path);
+    if (!text) {
+        perror(path);
+        exit(1);
+    }
+    int regressions = 0;
+    int n = metricCount < (int)(sizeof(metrics) / sizeof(metrics[0])) ? metricCount
+                                                                       : (int)(sizeof(metrics) / sizeof(metrics[0]));
+    for (int i = 0; i < n; i++) {
+        Metric* m = &metrics[i];
+        double base;
+        if (!baseline_lookup(text, m->name, &base) || base <= 0) {
+            fprintf(stderr, "  %-36s %14.1f %-5s (no baseline)\n", m->name, m->value, m->unit);
+            continue;
+        }
+        // 正数表示变差的百分比
+        double worse = m->higherIsBetter ? (base - m->value) / base * 100.0
+                                         : (m->value - base) / base * 100.0;
+        int bad = worse > threshold;
+        fprintf(stderr, "%s %-36s %14.1f -> %14.1f %-5s (%+.1f%%)\n", bad ? "!!" : "  ",
+                m->name, base, m->value, m->unit, m->higherIsBetter ? -worse : worse);
+        regressions += bad;
+    }
+    free(text);
+    return regressions;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--duration seconds] [--live 1000,10000,100000] [--threads 1,2,4]\n"
+            "          [--out file] [--baseline file] [--threshold percent]\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    double duration = 0.5;
+    int live[MAX_LIST] = {1000, 10000, 100000};
+    int nlive = 3;
+    int threads[MAX_LIST];
+    int nthreads = 0;
+    const char* outPath = NULL;
+    const char* baseline = NULL;
+    double threshold = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* v = argv[++i];
+        if (strcmp(a, "--duration") == 0) duration = atof(v);
+        else if (strcmp(a, "--live") == 0) nlive = bench_parse_ints(v, live, MAX_LIST);
+        else if (strcmp(a, "--threads") == 0) nthreads = bench_parse_ints(v, threads, MAX_LIST);
+        else if (strcmp(a, "--out") == 0) outPath = v;
+        else if (strcmp(a, "--baseline") == 0) baseline = v;
+        else if (strcmp(a, "--threshold") == 0) threshold = atof(v);
+        else usage(argv[0]);
+    }
+    if (duration <= 0 || threshold < 0) usage(argv[0]);
+
+    if (nthreads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        if (ncpu < 1) ncpu = 1;
+        for (int n = 1; n < ncpu && nthreads < MAX_LIST - 1; n *= 2)
+            threads[nthreads++] = n;
+        threads[nthreads++] = (int)ncpu;
+    }
+
+    FILE* out = stdout;
+    if (outPath && !(out = fopen(outPath, "w"))) {
+        perror(outPath);
+        return 1;
+    }
+
+    lua_State* L = bench_new_state();
+    if (!L) {
+        fprintf(stderr, "cannot create lua state\n");
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"benchmark\":\"xshare_microbench\",\"duration\":%.3f,\n  \"results\":[", duration);
+    for (size_t i = 0; i < SHAPE_COUNT; i++)
+        bench_roundtrip(L, &SHAPES[i], duration, out);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    bench_full_collect(gc_instance());
+    for (int i = 0; i < nlive; i++)
+        bench_pause(L, (size_t)live[i], out);
+    for (int i = 0; i < nthreads; i++)
+        bench_alloc(threads[i], duration, out);
+    fprintf(out, "\n  ]\n}\n");
+
+    lua_close(L);
+    if (out != stdout) fclose(out);
+
+    if (baseline) {
+        int regressions = compare_baseline(baseline, threshold);
+        if (regressions > 0) {
+            fprintf(stderr, "%d metric(s) regressed more than %.1f%% against %s\n", regressions, threshold, baseline);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,326 @@
+// table_bench.c
+// 共享表多线程扩展性基准：N 个线程各自持有一个 lua_State，并发访问同一个共享表，
+// 报告每种操作在不同线程数下的吞吐（ops/sec）和延迟分位数，结果以 JSON 输出。
+//
+// 用法：xshare_bench [--threads 1,2,4,8] [--duration 秒] [--small N] [--large N]
+//                    [--ops get,set,mixed,pairs,len,ipairs] [--label 文本] [--out 文件]
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define MAX_THREAD_COUNTS 32
+#define KEYS_PER_THREAD 65536   // 每个线程预生成的键序列长度
+#define POINT_BATCH 64          // 点操作每次计时的操作数，延迟取批次平均值
+#define ZIPF_EXPONENT 0.99
+
+// 各操作的 Lua 实现：ops[name](t, keys, pos, count, nkeys) -> 下一个 pos
+static const char* OPS_LUA =
+    "local ops = {}\n"
+    "function ops.get(t, keys, pos, count, nk)\n"
+    "  for i = 1, count do\n"
+    "    local v = t[keys[pos]]\n"
+    "    pos = pos % nk + 1\n"
+    "  end\n"
+    "  return pos\n"
+    "end\n"
+    "function ops.set(t, keys, pos, count, nk)\n"
+    "  for i = 1, count do\n"
+    "    local k = keys[pos]\n"
+    "    t[k] = k\n"
+    "    pos = pos % nk + 1\n"
+    "  end\n"
+    "  return pos\n"
+    "end\n"
+    "function ops.mixed(t, keys, pos, count, nk)\n"   // 90% 读，10% 写
+    "  for i = 1, count do\n"
+    "    local k = keys[pos]\n"
+    "    if i % 10 == 0 then t[k] = k else local v = t[k] end\n"
+    "    pos = pos % nk + 1\n"
+    "  end\n"
+    "  return pos\n"
+    "end\n"
+    "function ops.pairs(t, keys, pos)\n"
+    "  for k, v in pairs(t) do end\n"
+    "  return pos\n"
+    "end\n"
+    "function ops.len(t, keys, pos)\n"
+    "  local n = #t\n"
+    "  return pos\n"
+    "end\n"
+    "function ops.ipairs(t, keys, pos)\n"
+    "  for i, v in ipairs(t) do end\n"
+    "  return pos\n"
+    "end\n"
+    "return ops\n";
+
+// 创建并填充共享表：t[i] = i，i = 1..n
+static const char* FILL_LUA =
+    "local xshare, n = ...\n"
+    "local t = xshare.table()\n"
+    "for i = 1, n do t[i] = i end\n"
+    "return t\n";
+
+typedef struct OpInfo {
+    const char* name;
+    int batch;        // 每次调用执行的操作数
+    int keyed;        // 是否依赖键分布
+} OpInfo;
+
+static const OpInfo OPS[] = {
+    {"get", POINT_BATCH, 1},
+    {"set", POINT_BATCH, 1},
+    {"mixed", POINT_BATCH, 1},
+    {"pairs", 1, 0},
+    {"len", 1, 0},
+    {"ipairs", 1, 0},
+};
+#define OP_COUNT (sizeof(OPS) / sizeof(OPS[0]))
+
+typedef struct Case {
+    const OpInfo* op;
+    const char* sizeName;
+    size_t keys;
+    const char* dist;       // "uniform" / "zipf" / "none"
+    const double* cdf;      // zipf 时的累积分布表
+    int threads;
+    StoredObject* table;
+    atomic_int stop;
+    pthread_mutex_t mutex;  // 启动闸门：所有线程就绪后同时开始
+    pthread_cond_t cond;
+    int ready;
+    int go;
+} Case;
+
+typedef struct Worker {
+    pthread_t thread;
+    Case* c;
+    int id;
+    uint64_t ops;
+    BenchSamples lat;
+} Worker;
+
+static void* worker_main(void* arg) {
+    Worker* w = (Worker*)arg;
+    Case* c = w->c;
+    lua_State* L = bench_new_state();
+    if (!L) {
+        fprintf(stderr, "cannot create lua state\n");
+        exit(1);
+    }
+
+    bench_run_chunk(L, OPS_LUA, "ops", 0, 1);
+    lua_getfield(L, -1, c->op->name);
+    int fn = lua_gettop(L);
+    stored_push(L, c->table);
+    int t = lua_gettop(L);
+
+    // 预生成键序列
+    uint64_t seed = 0x9E3779B97F4A7C15ULL * (uint64_t)(w->id + 1);
+    lua_createtable(L, KEYS_PER_THREAD, 0);
+    int keys = lua_gettop(L);
+    for (int i = 1; i <= KEYS_PER_THREAD; i++) {
+        size_t k = c->cdf ? bench_zipf_sample(c->cdf, c->keys, &seed)
+                          : (size_t)(bench_rand(&seed) % c->keys);
+        lua_pushinteger(L, (lua_Integer)k + 1);
+        lua_rawseti(L, keys, i);
+    }
+
+    pthread_mutex_lock(&c->mutex);
+    c->ready++;
+    pthread_cond_broadcast(&c->cond);
+    while (!c->go)
+        pthread_cond_wait(&c->cond, &c->mutex);
+    pthread_mutex_unlock(&c->mutex);
+
+    lua_Integer pos = 1;
+    int batch = c->op->batch;
+    while (!atomic_load_explicit(&c->stop, memory_order_relaxed)) {
+        lua_pushvalue(L, fn);
+        lua_pushvalue(L, t);
+        lua_pushvalue(L, keys);
+        lua_pushinteger(L, pos);
+        lua_pushinteger(L, batch);
+        lua_pushinteger(L, KEYS_PER_THREAD);
+        uint64_t start = bench_now_ns();
+        if (lua_pcall(L, 5, 1, 0) != LUA_OK) {
+            fprintf(stderr, "%s: %s\n", c->op->name, lua_tostring(L, -1));
+            exit(1);
+        }
+        uint64_t elapsed = bench_now_ns() - start;
+        pos = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        w->ops += (uint64_t)batch;
+        bench_samples_add(&w->lat, elapsed / (uint64_t)batch);
+    }
+
+    lua_close(L);
+    return NULL;
+}
+
+// 运行一个用例，输出一条 JSON 结果
+static void run_case(lua_State* L0, Case* c, double duration, FILE* out, int* first) {
+    // 在主状态中创建并填充共享表
+    lua_getglobal(L0, "xshare");
+    lua_pushinteger(L0, (lua_Integer)c->keys);
+    bench_run_chunk(L0, FILL_LUA, "fill", 2, 1);
+    c->table = stored_create(L0, -1);
+    lua_pop(L0, 1);
+
+    atomic_store(&c->stop, 0);
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    c->ready = 0;
+    c->go = 0;
+
+    Worker* workers = (Worker*)calloc((size_t)c->threads, sizeof(Worker));
+    if (!workers) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < c->threads; i++) {
+        workers[i].c = c;
+        workers[i].id = i;
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "cannot create thread\n");
+            exit(1);
+        }
+    }
+
+    pthread_mutex_lock(&c->mutex);
+    while (c->ready < c->threads)
+        pthread_cond_wait(&c->cond, &c->mutex);
+    c->go = 1;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+
+    uint64_t start = bench_now_ns();
+    bench_sleep(duration);
+    atomic_store(&c->stop, 1);
+    for (int i = 0; i < c->threads; i++)
+        pthread_join(workers[i].thread, NULL);
+    double elapsed = (double)(bench_now_ns() - start) / 1e9;
+
+    uint64_t ops = 0;
+    BenchSamples lat = {0};
+    for (int i = 0; i < c->threads; i++) {
+        ops += workers[i].ops;
+        bench_samples_merge(&lat, &workers[i].lat);
+        bench_samples_free(&workers[i].lat);
+    }
+    free(workers);
+
+    fprintf(out, "%s\n    {\"op\":\"%s\",\"size\":\"%s\",\"keys\":%zu,\"dist\":\"%s\",\"threads\":%d,"
+                 "\"ops\":%llu,\"seconds\":%.6f,\"ops_per_sec\":%.1f,",
+            *first ? "" : ",", c->op->name, c->sizeName, c->keys, c->dist, c->threads,
+            (unsigned long long)ops, elapsed, (double)ops / elapsed);
+    bench_json_latency(out, &lat);
+    fprintf(out, "}");
+    fflush(out);
+    *first = 0;
+    bench_samples_free(&lat);
+
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mutex);
+
+    // 释放共享表并回收，避免影响下一个用例
+    gc_release((GCObject*)c->table);
+    lua_gc(L0, LUA_GCCOLLECT, 0);
+    bench_full_collect(gc_instance());
+}
+
+static int op_selected(const char* list, const char* name) {
+    if (!list) return 1;
+    size_t len = strlen(name);
+    for (const char* p = list; (p = strstr(p, name)) != NULL; p += len) {
+        if ((p == list || p[-1] == ',') && (p[len] == '\0' || p[len] == ','))
+            return 1;
+    }
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--threads 1,2,4,8] [--duration seconds] [--small N] [--large N]\n"
+            "          [--ops get,set,mixed,pairs,len,ipairs] [--label text] [--out file]\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    int threads[MAX_THREAD_COUNTS];
+    int nthreads = 0;
+    double duration = 1.0;
+    size_t small = 16, large = 65536;
+    const char* opsList = NULL;
+    const char* label = "";
+    const char* outPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* v = argv[++i];
+        if (strcmp(a, "--threads") == 0) nthreads = bench_parse_ints(v, threads, MAX_THREAD_COUNTS);
+        else if (strcmp(a, "--duration") == 0) duration = atof(v);
+        else if (strcmp(a, "--small") == 0) small = (size_t)strtoull(v, NULL, 10);
+        else if (strcmp(a, "--large") == 0) large = (size_t)strtoull(v, NULL, 10);
+        else if (strcmp(a, "--ops") == 0) opsList = v;
+        else if (strcmp(a, "--label") == 0) label = v;
+        else if (strcmp(a, "--out") == 0) outPath = v;
+        else usage(argv[0]);
+    }
+    if (duration <= 0 || small == 0 || large == 0) usage(argv[0]);
+
+    // 默认线程数：1, 2, 4, ... 直到 CPU 核数
+    if (nthreads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        if (ncpu < 1) ncpu = 1;
+        for (int n = 1; n < ncpu && nthreads < MAX_THREAD_COUNTS - 1; n *= 2)
+            threads[nthreads++] = n;
+        threads[nthreads++] = (int)ncpu;
+    }
+
+    FILE* out = stdout;
+    if (outPath && !(out = fopen(outPath, "w"))) {
+        perror(outPath);
+        return 1;
+    }
+
+    lua_State* L0 = bench_new_state();
+    if (!L0) {
+        fprintf(stderr, "cannot create lua state\n");
+        return 1;
+    }
+
+    const struct { const char* name; size_t keys; } sizes[] = {{"small", small}, {"large", large}};
+    fprintf(out, "{\n  \"benchmark\":\"xshare_bench\",\"label\":\"%s\",\"duration\":%.3f,\n  \"results\":[", label, duration);
+    int first = 1;
+    for (size_t o = 0; o < OP_COUNT; o++) {
+        const OpInfo* op = &OPS[o];
+        if (!op_selected(opsList, op->name)) continue;
+        for (size_t s = 0; s < 2; s++) {
+            double* cdf = op->keyed ? bench_zipf_cdf(sizes[s].keys, ZIPF_EXPONENT) : NULL;
+            int ndist = (op->keyed && cdf) ? 2 : 1;   // zipf 表分配失败时只跑均匀分布
+            for (int d = 0; d < ndist; d++) {
+                for (int t = 0; t < nthreads; t++) {
+                    Case c;
+                    memset(&c, 0, sizeof(c));
+                    c.op = op;
+                    c.sizeName = sizes[s].name;
+                    c.keys = sizes[s].keys;
+                    c.dist = !op->keyed ? "none" : (d == 0 ? "uniform" : "zipf");
+                    c.cdf = d == 1 ? cdf : NULL;
+                    c.threads = threads[t];
+                    run_case(L0, &c, duration, out, &first);
+                }
+            }
+            free(cdf);
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    lua_close(L0);
+    if (out != stdout) fclose(out);
+    return 0;
+}
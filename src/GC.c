@@ -1,71 +1,202 @@
 #include "GC.h"
+#include "slab.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
 
 GC* gc_instance(void) {
     static GC global_gc = {
-        .head = NULL,
-        .tail = NULL,
         .count = 0,
+        .youngLimit = GC_DEFAULT_YOUNG_LIMIT,
+        .threads = 1,
+        .sweepBudget = GC_DEFAULT_SWEEP_BUDGET,
         .enabled = 1,
         .step = 2.0,
         .lastCleanup = 100,
-        .rwlock = PTHREAD_RWLOCK_INITIALIZER
+        .lastCleanupBytes = GC_MIN_TRIGGER_BYTES,
+        .rwlock = PTHREAD_RWLOCK_INITIALIZER,
+        .bgMutex = PTHREAD_MUTEX_INITIALIZER,
+        .bgCond = PTHREAD_COND_INITIALIZER
     };
     return &global_gc;
 }
 
-/* 内部：确保强引用数组有足够容量（必须持有写锁） */
-static int ensure_strong_capacity(GCObject* obj, int needed) {
-    if (needed <= obj->strongCapacity) return 1;
-    
-    int newCap = obj->strongCapacity * 2;
-    if (newCap < needed) newCap = needed;
-    
-    GCObject** newRefs = (GCObject**)realloc(obj->strongRefs, newCap * sizeof(GCObject*));
-    if (!newRefs) return 0;   // 内存不足
-    
-    obj->strongRefs = newRefs;
-    obj->strongCapacity = newCap;
-    return 1;
+GC* gc_new(void) {
+    GC* gc = (GC*)calloc(1, sizeof(GC));
+    if (!gc) return NULL;
+    gc->youngLimit = GC_DEFAULT_YOUNG_LIMIT;
+    gc->threads = 1;
+    gc->sweepBudget = GC_DEFAULT_SWEEP_BUDGET;
+    gc->enabled = 1;
+    gc->step = 2.0;
+    gc->lastCleanup = 100;
+    gc->lastCleanupBytes = GC_MIN_TRIGGER_BYTES;
+    atomic_init(&gc->handles, 1);
+    if (pthread_rwlock_init(&gc->rwlock, NULL) != 0) {
+        free(gc);
+        return NULL;
+    }
+    if (pthread_mutex_init(&gc->bgMutex, NULL) != 0) {
+        pthread_rwlock_destroy(&gc->rwlock);
+        free(gc);
+        return NULL;
+    }
+    if (pthread_cond_init(&gc->bgCond, NULL) != 0) {
+        pthread_mutex_destroy(&gc->bgMutex);
+        pthread_rwlock_destroy(&gc->rwlock);
+        free(gc);
+        return NULL;
+    }
+    return gc;
+}
+
+/* 内部：销毁已经没有对象和句柄的堆 */
+static void heap_destroy(GC* gc) {
+    pthread_cond_destroy(&gc->bgCond);
+    pthread_mutex_destroy(&gc->bgMutex);
+    pthread_rwlock_destroy(&gc->rwlock);
+    free(gc);
+}
+
+/* 内部：内存统计（原子累加，负数按模运算） */
+static inline void add_bytes(GC* gc, GCMemKind mem, int kind, ptrdiff_t delta) {
+    atomic_fetch_add_explicit(&gc->bytes, (size_t)delta, memory_order_relaxed);
+    atomic_fetch_add_explicit(&gc->memBytes[mem], (size_t)delta, memory_order_relaxed);
+    atomic_fetch_add_explicit(&gc->kindBytes[kind], (size_t)delta, memory_order_relaxed);
+}
+
+static inline void add_object(GC* gc, GCObject* obj, int sign) {
+    atomic_fetch_add_explicit(&gc->kindObjects[obj->kind], (size_t)(ptrdiff_t)sign, memory_order_relaxed);
+    add_bytes(gc, GC_MEM_OBJECT, obj->kind, sign * (ptrdiff_t)obj->size);
+}
+
+/* 内部：链表操作（必须持有写锁） */
+static void list_append(GCList* list, GCObject* obj) {
+    obj->prev = list->tail;
+    obj->next = NULL;
+    if (list->tail)
+        list->tail->next = obj;
+    else
+        list->head = obj;
+    list->tail = obj;
+    list->count++;
+}
+
+static void list_remove(GCList* list, GCObject* obj) {
+    if (obj->prev) obj->prev->next = obj->next;
+    else list->head = obj->next;
+    if (obj->next) obj->next->prev = obj->prev;
+    else list->tail = obj->prev;
+    list->count--;
 }
 
 /* 内部：分配新对象，返回已加入链表的对象（必须持有写锁） */
 static GCObject* alloc_object(GC* gc, size_t data_size) {
-    GCObject* obj = (GCObject*)malloc(sizeof(GCObject) + data_size);
+    size_t size = sizeof(GCObject) + data_size;
+    GCObject* obj = (GCObject*)slab_alloc(size);
     if (!obj) return NULL;
+    obj->size = size;
+    obj->kind = 0;
+    obj->gc = gc;
+    add_object(gc, obj, 1);
     
-    atomic_init(&obj->refCount, 1);   // GC自身持有1个引用
-    obj->mark = 0;
-    obj->strongCapacity = 4;
-    obj->strongSize = 0;
+    atomic_init(&obj->refCount, 2);   // GC自身持有1个引用，调用者持有1个
+    atomic_init(&obj->mark, 0);
+    obj->flags = 0;
+    atomic_init(&obj->gcRefs, 0);
+    obj->gen = GC_YOUNG;
+    obj->age = 0;
+    atomic_init(&obj->pending, 0);
+    obj->nextFree = NULL;
+    obj->dtor = NULL;
+    obj->trace = NULL;
+    memset(gc_userdata(obj), 0, data_size);
     
-    obj->strongRefs = (GCObject**)malloc(obj->strongCapacity * sizeof(GCObject*));
-    if (!obj->strongRefs) {
-        free(obj);
-        return NULL;
-    }
-    
-    /* 插入链表尾部 */
-    obj->prev = gc->tail;
-    obj->next = NULL;
-    if (gc->tail)
-        gc->tail->next = obj;
-    else
-        gc->head = obj;
-    gc->tail = obj;
+    /* 插入新生代链表尾部 */
+    list_append(&gc->gens[GC_YOUNG], obj);
     gc->count++;
     
     return obj;
 }
 
+/* 内部：从所在代的链表中摘除对象（必须持有写锁） */
+static void unlink_object(GC* gc, GCObject* obj) {
+    list_remove(&gc->gens[obj->gen], obj);
+    gc->count--;
+}
+
+/* 内部：调用析构函数并释放已摘除的对象 */
+static void destroy_object(GCObject* obj) {
+    if (obj->dtor) {
+        obj->dtor(obj);
+    }
+    add_object(obj->gc, obj, -1);
+    slab_free(obj, obj->size);
+}
+
+/* 内部：释放待释放链表中仍处于基线的叶子对象（必须持有写锁）。
+ * 入链后又被 retain 的对象清除 pending 标志后保留 */
+static void drain_free_list(GC* gc) {
+    GCObject* obj = atomic_exchange(&gc->freeList, NULL);
+    while (obj) {
+        GCObject* next = obj->nextFree;
+        if (atomic_load(&obj->refCount) == 1) {
+            unlink_object(gc, obj);
+            destroy_object(obj);
+        } else {
+            atomic_store(&obj->pending, 0);
+        }
+        obj = next;
+    }
+}
+
+/* 内部：对象数或字节数（加上预计增量）是否达到触发阈值（必须持有写锁） */
+static int over_threshold(GC* gc, double extraObjects, double extraBytes) {
+    if (gc->count + extraObjects >= gc->step * gc->lastCleanup) return 1;
+    return atomic_load(&gc->bytes) + extraBytes >= gc->step * gc->lastCleanupBytes;
+}
+
+/* 内部：新生代是否达到次要收集阈值（必须持有写锁） */
+static int young_over_limit(GC* gc) {
+    return gc->youngLimit > 0 && gc->gens[GC_YOUNG].count >= gc->youngLimit;
+}
+
+/* 内部：单调时钟（秒） */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 内部：取得堆的写锁；追踪时记录超过阈值的等待 */
+static void heap_wrlock(GC* gc) {
+    if (!trace_enabled() || pthread_rwlock_trywrlock(&gc->rwlock) != 0) {
+        uint64_t start = trace_enabled() ? trace_now() : 0;
+        pthread_rwlock_wrlock(&gc->rwlock);
+        if (start)
+            trace_slow("gc.wrlock", "lock", start, trace_now() - start, NULL, 0);
+    }
+}
+
 GCObject* gc_create(GC* gc, size_t data_size) {
-    pthread_rwlock_wrlock(&gc->rwlock);   // 写锁，因为可能触发GC且需修改链表
+    heap_wrlock(gc);   // 写锁，因为可能触发GC且需修改链表
+    drain_free_list(gc);
+    if (gc->sweepHead && gc->bgRunning != 1)
+        gc_sweep(gc, 0);   // 分配时顺带清除一步；后台线程运行时由它负责
     
-    /* 根据阈值决定是否自动收集 */
-    if (gc->enabled && gc->count >= gc->step * gc->lastCleanup) {
-        gc_collect(gc);   // 已持有写锁，直接收集
+    /* 根据阈值决定是否自动收集；后台线程运行时只唤醒它，不在调用线程内收集。
+     * 总量超过阈值做完整收集，否则新生代满时只做次要收集 */
+    if (gc->enabled && (over_threshold(gc, 0, 0) || young_over_limit(gc))) {
+        if (gc->bgRunning == 1)
+            pthread_cond_signal(&gc->bgCond);
+        else if (over_threshold(gc, 0, 0))
+            gc_collect(gc);   // 已持有写锁，直接收集
+        else
+            gc_collect_minor(gc);
     }
     
     GCObject* obj = alloc_object(gc, data_size);
@@ -73,123 +204,795 @@ GCObject* gc_create(GC* gc, size_t data_size) {
     return obj;
 }
 
+void gc_set_kind(GCObject* obj, int kind) {
+    if (kind < 0 || kind >= GC_MAX_KINDS || kind == obj->kind) return;
+    add_object(obj->gc, obj, -1);
+    obj->kind = kind;
+    add_object(obj->gc, obj, 1);
+}
+
+void gc_account(GCObject* obj, GCMemKind mem, ptrdiff_t delta) {
+    add_bytes(obj->gc, mem, obj->kind, delta);
+}
+
 void gc_retain(GCObject* obj) {
-    GC* gc = gc_instance();
     atomic_fetch_add(&obj->refCount, 1);
 }
 
 void gc_release(GCObject* obj) {
-    GC* gc = gc_instance();
+    GC* gc = obj->gc;
     int old = atomic_fetch_sub(&obj->refCount, 1);
-    assert(old > 0);
+    assert(old > 1);   // GC自身持有的1个引用只在回收时放弃
+    if (old == 2 && (obj->flags & GC_FLAG_LEAF) &&
+        atomic_exchange(&obj->pending, 1) == 0) {
+        /* 压入无锁栈；这里不能直接释放，调用者可能正持有写锁（例如在析构函数中） */
+        GCObject* head = atomic_load(&gc->freeList);
+        do {
+            obj->nextFree = head;
+        } while (!atomic_compare_exchange_weak(&gc->freeList, &head, obj));
+    }
 }
 
-void gc_add_reference(GCObject* from, GCObject* to) {
-    if (!from || !to) return;
-    GC* gc = gc_instance();
-    pthread_rwlock_wrlock(&gc->rwlock);
-    
-    if (!ensure_strong_capacity(from, from->strongSize + 1)) {
-        // 内存不足，放弃添加引用
-        pthread_rwlock_unlock(&gc->rwlock);
-        return;
-    }
-    
-    from->strongRefs[from->strongSize++] = to;
-    gc_retain(to);   // 增加目标对象的引用计数
+void gc_mutate_begin(GC* gc) {
+    pthread_rwlock_rdlock(&gc->rwlock);
+}
+
+void gc_mutate_end(GC* gc) {
     pthread_rwlock_unlock(&gc->rwlock);
 }
 
-void gc_remove_reference(GCObject* from, GCObject* to) {
-    if (!from || !to) return;
-    GC* gc = gc_instance();
-    pthread_rwlock_wrlock(&gc->rwlock);
-    
-    for (int i = 0; i < from->strongSize; i++) {
-        if (from->strongRefs[i] == to) {
-            // 用最后一个元素覆盖要删除的元素
-            from->strongRefs[i] = from->strongRefs[--from->strongSize];
-            gc_release(to);   // 减少目标对象的引用计数
-            break;
+/* 每处理这么多对象检查一次取消标志 */
+#define GC_CANCEL_CHECK_INTERVAL 1024
+
+/* 内部：记录一次收集的耗时（必须持有写锁） */
+static void record_timing(GC* gc, double start, size_t objects, int minor, int cancelled) {
+    double pause = now_seconds() - start;
+    if (cancelled) {
+        gc->timing.cancelled++;
+    } else if (minor) {
+        gc->timing.minorCycles++;   // 单对象耗时估算只使用完整收集
+    } else {
+        gc->timing.cycles++;
+        gc->timing.lastObjects = objects;
+    }
+    gc->timing.lastPause = pause;
+    gc->timing.totalPause += pause;
+    if (pause > gc->timing.maxPause)
+        gc->timing.maxPause = pause;
+}
+
+/* 收集期临时字段（mark、gcRefs）的访问。单线程收集用 relaxed 读写；
+ * 并行收集中多个线程可能同时修改同一对象，改用原子读改写（见 par_visit_*） */
+static inline int get_mark(const GCObject* obj) {
+    return atomic_load_explicit(&obj->mark, memory_order_relaxed);
+}
+
+static inline void set_mark(GCObject* obj, int mark) {
+    atomic_store_explicit(&obj->mark, mark, memory_order_relaxed);
+}
+
+static inline int get_refs(const GCObject* obj) {
+    return atomic_load_explicit(&obj->gcRefs, memory_order_relaxed);
+}
+
+static inline void set_refs(GCObject* obj, int refs) {
+    atomic_store_explicit(&obj->gcRefs, refs, memory_order_relaxed);
+}
+
+/* 内部：引用目标是否在本次收集范围内。其他堆的对象（可能正被它自己的收集器处理）
+ * 和次要收集时的老年代对象都不触碰 */
+static inline int in_scope(const GC* gc, int minor, const GCObject* ref) {
+    return ref->gc == gc && (!minor || ref->gen == GC_YOUNG);
+}
+
+/* 标记传播时的灰色队列，也作为两个遍历回调的上下文 */
+typedef struct GreyQueue {
+    GC* gc;                         /* 正在收集的堆 */
+    GCObject** items;
+    int size;
+    int minor;                      /* 次要收集：不处理老年代对象 */
+} GreyQueue;
+
+/* 试删除：每条内部强引用扣减目标的外部引用数 */
+static void visit_unref(GCObject* ref, void* ud) {
+    GreyQueue* q = (GreyQueue*)ud;
+    if (!in_scope(q->gc, q->minor, ref)) return;
+    set_refs(ref, get_refs(ref) - 1);
+}
+
+static void visit_mark(GCObject* ref, void* ud) {
+    GreyQueue* q = (GreyQueue*)ud;
+    if (!in_scope(q->gc, q->minor, ref)) return;
+    if (get_mark(ref) == 0) {
+        set_mark(ref, 1);
+        q->items[q->size++] = ref;
+    }
+}
+
+/* 内部：新生代存活对象年龄加一，达到 GC_PROMOTE_AGE 的晋升老年代（必须持有写锁） */
+static void promote_survivors(GC* gc) {
+    GCObject* obj = gc->gens[GC_YOUNG].head;
+    while (obj) {
+        GCObject* next = obj->next;
+        if (++obj->age >= GC_PROMOTE_AGE) {
+            list_remove(&gc->gens[GC_YOUNG], obj);
+            obj->gen = GC_OLD;
+            list_append(&gc->gens[GC_OLD], obj);
         }
+        obj = next;
     }
-    
-    /* 缩容优化：当实际使用量小于容量的1/3且容量大于4时，尝试缩小一半 */
-    if (from->strongSize * 3 < from->strongCapacity && from->strongCapacity > 4) {
-        int newCap = from->strongCapacity / 2;
-        if (newCap < 4) newCap = 4;
-        GCObject** newRefs = (GCObject**)realloc(from->strongRefs, newCap * sizeof(GCObject*));
-        if (newRefs) {
-            from->strongRefs = newRefs;
-            from->strongCapacity = newCap;
+}
+
+/* 内部：单线程标记与清除（必须持有写锁）。buf 容量为本次扫描的对象数，先用作灰色队列，
+ * 再用作死亡对象数组。返回死亡对象数（均已摘除并析构，尚未释放），-1 表示被取消 */
+static int mark_sweep_serial(GC* gc, int minor, GCObject** buf) {
+    int ngens = minor ? 1 : 2;   // GC_YOUNG 为0，次要收集只遍历第一个链表
+    GreyQueue q = { gc, buf, 0, minor };
+
+    /* 第一步：试删除。重置为白色，引用计数减去GC基线，再减去每条 trace 到的内部强引用，
+     * 剩余大于0的对象被GC之外持有，即为根（refCount 中包含了所有强引用的计数）。
+     * 次要收集不遍历老年代，老年代指向新生代的边不被扣除，被引用者自然成为根；
+     * 其他堆指向本堆的边同理 */
+    for (int g = 0; g < ngens; g++) {
+        for (GCObject* obj = gc->gens[g].head; obj; obj = obj->next) {
+            set_mark(obj, 0);
+            set_refs(obj, atomic_load(&obj->refCount) - 1);
         }
     }
-    
-    pthread_rwlock_unlock(&gc->rwlock);
+    for (int g = 0; g < ngens; g++) {
+        for (GCObject* obj = gc->gens[g].head; obj; obj = obj->next) {
+            if (obj->trace)
+                obj->trace(obj, visit_unref, &q);
+        }
+    }
+    for (int g = 0; g < ngens; g++) {
+        for (GCObject* obj = gc->gens[g].head; obj; obj = obj->next) {
+            if (get_refs(obj) > 0) {
+                buf[q.size++] = obj;
+                set_mark(obj, 1);   // 灰色
+            }
+        }
+    }
+
+    /* 第二步：标记传播（可被取消：标记尚未生效，直接放弃即可） */
+    for (int i = 0; i < q.size; i++) {
+        if (i % GC_CANCEL_CHECK_INTERVAL == 0 && atomic_load(&gc->cancel))
+            return -1;
+        GCObject* cur = buf[i];
+        if (cur->trace)
+            cur->trace(cur, visit_mark, &q);
+        set_mark(cur, 2);   // 黑色
+    }
+
+    /* 第三步：摘除白色对象并置 pending（析构函数对它们的 release 不再入链），
+     * 析构与释放交给待清除队列分步完成（见 enqueue_dead / gc_sweep） */
+    int deadSize = 0;
+    for (int g = 0; g < ngens; g++) {
+        GCObject* obj = gc->gens[g].head;
+        while (obj) {
+            GCObject* next = obj->next;
+            /* 收集期间被其他线程压入待释放链表的叶子对象留给 drain_free_list 处理 */
+            if (get_mark(obj) == 0 && atomic_exchange(&obj->pending, 1) == 0) {
+                unlink_object(gc, obj);
+                buf[deadSize++] = obj;   // 灰色队列已用完，复用为死亡对象数组
+            }
+            obj = next;
+        }
+    }
+    return deadSize;
 }
 
-void gc_collect(GC* gc) {
+/* ---------- 并行标记与清除 ---------- */
+
+/* 简单屏障（部分平台没有 pthread_barrier_t） */
+typedef struct Barrier {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int count;
+    int waiting;
+    unsigned phase;
+} Barrier;
+
+static void barrier_wait(Barrier* b) {
+    pthread_mutex_lock(&b->mutex);
+    unsigned phase = b->phase;
+    if (++b->waiting == b->count) {
+        b->waiting = 0;
+        b->phase++;
+        pthread_cond_broadcast(&b->cond);
+    } else {
+        while (phase == b->phase)
+            pthread_cond_wait(&b->cond, &b->mutex);
+    }
+    pthread_mutex_unlock(&b->mutex);
+}
+
+/* 每个工作线程的灰色栈。所有者从栈顶压入/弹出，空闲线程从其他栈顶窃取一半 */
+typedef struct GreyStack {
+    pthread_mutex_t lock;
+    GCObject** items;
+    size_t size;
+    size_t cap;
+} GreyStack;
+
+/* 并行收集的共享状态 */
+typedef struct ParallelMark {
+    GC* gc;
+    int minor;
+    int nthreads;
+    GCObject** objs;                /* 本次扫描的所有对象，清除阶段原地压缩为死亡对象 */
+    size_t count;
+    GreyStack* stacks;
+    size_t* dead;                   /* 每个线程分段内的死亡对象数 */
+    atomic_int active;              /* 仍有工作的线程数，降到0时标记结束 */
+    atomic_int abort;               /* 1取消，2内存不足 */
+    int go;                         /* 启动闸门：0等待，1开始，-1放弃（受 barrier.mutex 保护） */
+    Barrier barrier;
+} ParallelMark;
+
+typedef struct MarkWorker {
+    ParallelMark* pm;
+    int id;
+    pthread_t thread;
+} MarkWorker;
+
+static int stack_push(GreyStack* s, GCObject* obj) {
+    pthread_mutex_lock(&s->lock);
+    if (s->size == s->cap) {
+        size_t newcap = s->cap ? s->cap * 2 : 256;
+        GCObject** items = (GCObject**)realloc(s->items, newcap * sizeof(GCObject*));
+        if (!items) {
+            pthread_mutex_unlock(&s->lock);
+            return 0;
+        }
+        s->items = items;
+        s->cap = newcap;
+    }
+    s->items[s->size++] = obj;
+    pthread_mutex_unlock(&s->lock);
+    return 1;
+}
+
+static GCObject* stack_pop(GreyStack* s) {
+    pthread_mutex_lock(&s->lock);
+    GCObject* obj = s->size ? s->items[--s->size] : NULL;
+    pthread_mutex_unlock(&s->lock);
+    return obj;
+}
+
+/* 从 victim 栈顶窃取一半压入 own，返回是否窃取到 */
+static int stack_steal(GreyStack* victim, GreyStack* own, atomic_int* abort) {
+    GCObject* batch[64];
+    pthread_mutex_lock(&victim->lock);
+    size_t n = (victim->size + 1) / 2;
+    if (n > 64) n = 64;
+    victim->size -= n;
+    memcpy(batch, victim->items + victim->size, n * sizeof(GCObject*));
+    pthread_mutex_unlock(&victim->lock);
+    for (size_t i = 0; i < n; i++) {
+        if (!stack_push(own, batch[i]))
+            atomic_store(abort, 2);
+    }
+    return n > 0;
+}
+
+static void par_visit_unref(GCObject* ref, void* ud) {
+    MarkWorker* w = (MarkWorker*)ud;
+    if (!in_scope(w->pm->gc, w->pm->minor, ref)) return;
+    atomic_fetch_sub_explicit(&ref->gcRefs, 1, memory_order_relaxed);
+}
+
+/* 白色置灰：CAS 保证每个对象只被一个线程压栈 */
+static void par_grey(MarkWorker* w, GCObject* obj) {
+    int white = 0;
+    if (atomic_compare_exchange_strong_explicit(&obj->mark, &white, 1,
+                                                memory_order_relaxed, memory_order_relaxed) &&
+        !stack_push(&w->pm->stacks[w->id], obj))
+        atomic_store(&w->pm->abort, 2);
+}
+
+static void par_visit_mark(GCObject* ref, void* ud) {
+    MarkWorker* w = (MarkWorker*)ud;
+    if (!in_scope(w->pm->gc, w->pm->minor, ref)) return;
+    par_grey(w, ref);
+}
+
+/* 标记传播：处理自己的栈，空了就去其他栈窃取；所有线程都空闲时结束 */
+static void par_propagate(MarkWorker* w) {
+    ParallelMark* pm = w->pm;
+    GreyStack* own = &pm->stacks[w->id];
+    size_t done = 0;
+    for (;;) {
+        GCObject* cur;
+        while (!atomic_load_explicit(&pm->abort, memory_order_relaxed) && (cur = stack_pop(own))) {
+            if (++done % GC_CANCEL_CHECK_INTERVAL == 0 && atomic_load(&pm->gc->cancel))
+                atomic_store(&pm->abort, 1);
+            if (cur->trace)
+                cur->trace(cur, par_visit_mark, w);
+            set_mark(cur, 2);   // 黑色
+        }
+        /* 只有活跃线程会向自己的栈压入对象，活跃数为0时所有栈都已空 */
+        atomic_fetch_sub(&pm->active, 1);
+        int stole = 0;
+        while (!stole) {
+            if (atomic_load(&pm->active) == 0 || atomic_load(&pm->abort))
+                return;
+            for (int i = 1; i < pm->nthreads && !stole; i++) {
+                GreyStack* victim = &pm->stacks[(w->id + i) % pm->nthreads];
+                atomic_fetch_add(&pm->active, 1);
+                stole = stack_steal(victim, own, &pm->abort);
+                if (!stole)
+                    atomic_fetch_sub(&pm->active, 1);
+            }
+            if (!stole)
+                sched_yield();
+        }
+    }
+}
+
+/* 工作线程主体。对象数组按线程均分，各阶段之间用屏障同步；0号线程即调用 gc_collect 的线程。
+ * 结束时各段开头是该段的死亡对象（已置 pending），由调用线程串行摘除 */
+static void* par_worker(void* arg) {
+    MarkWorker* w = (MarkWorker*)arg;
+    ParallelMark* pm = w->pm;
+
+    /* 等待所有线程创建完毕，任一创建失败则整体放弃 */
+    pthread_mutex_lock(&pm->barrier.mutex);
+    while (pm->go == 0)
+        pthread_cond_wait(&pm->barrier.cond, &pm->barrier.mutex);
+    int go = pm->go;
+    pthread_mutex_unlock(&pm->barrier.mutex);
+    if (go < 0)
+        return NULL;
+
+    size_t lo = pm->count * w->id / pm->nthreads;
+    size_t hi = pm->count * (w->id + 1) / pm->nthreads;
+
+    /* 试删除（同 mark_sweep_serial 第一步） */
+    for (size_t i = lo; i < hi; i++) {
+        set_mark(pm->objs[i], 0);
+        set_refs(pm->objs[i], atomic_load(&pm->objs[i]->refCount) - 1);
+    }
+    barrier_wait(&pm->barrier);
+    for (size_t i = lo; i < hi; i++) {
+        if (pm->objs[i]->trace)
+            pm->objs[i]->trace(pm->objs[i], par_visit_unref, w);
+    }
+    barrier_wait(&pm->barrier);
+
+    /* 根置灰后直接开始传播，其他线程可能仍在找根，它们计入活跃数 */
+    for (size_t i = lo; i < hi; i++) {
+        if (get_refs(pm->objs[i]) > 0)
+            par_grey(w, pm->objs[i]);
+    }
+    par_propagate(w);
+    barrier_wait(&pm->barrier);
+    if (atomic_load(&pm->abort))
+        return NULL;
+
+    /* 清除：各段内原地压缩出死亡对象 */
+    size_t n = lo;
+    for (size_t i = lo; i < hi; i++) {
+        GCObject* obj = pm->objs[i];
+        if (get_mark(obj) == 0 && atomic_exchange(&obj->pending, 1) == 0)
+            pm->objs[n++] = obj;
+    }
+    pm->dead[w->id] = n - lo;
+    return NULL;
+}
+
+/* 内部：本次收集使用的线程数 */
+static int parallel_threads(GC* gc, size_t objCount) {
+    size_t n = objCount / GC_PARALLEL_MIN_PER_THREAD;
+    if (n > (size_t)gc->threads) n = gc->threads;
+    return n > 1 ? (int)n : 1;
+}
+
+/* 内部：并行标记与清除，约定同 mark_sweep_serial。buf 被填充为本次扫描的对象数组。
+ * 返回 -2 表示内存不足或线程创建失败（跳过本次收集） */
+static int mark_sweep_parallel(GC* gc, int minor, GCObject** buf, int nthreads) {
+    ParallelMark pm;
+    pm.gc = gc;
+    pm.minor = minor;
+    pm.nthreads = nthreads;
+    pm.objs = buf;
+    pm.count = 0;
+    for (int g = 0; g < (minor ? 1 : 2); g++) {
+        for (GCObject* obj = gc->gens[g].head; obj; obj = obj->next)
+            buf[pm.count++] = obj;
+    }
+    atomic_init(&pm.active, nthreads);
+    atomic_init(&pm.abort, 0);
+    pm.stacks = (GreyStack*)calloc(nthreads, sizeof(GreyStack));
+    pm.dead = (size_t*)calloc(nthreads, sizeof(size_t));
+    MarkWorker* workers = (MarkWorker*)calloc(nthreads, sizeof(MarkWorker));
+    if (!pm.stacks || !pm.dead || !workers) {
+        free(pm.stacks);
+        free(pm.dead);
+        free(workers);
+        return -2;
+    }
+    for (int i = 0; i < nthreads; i++)
+        pthread_mutex_init(&pm.stacks[i].lock, NULL);
+    pthread_mutex_init(&pm.barrier.mutex, NULL);
+    pthread_cond_init(&pm.barrier.cond, NULL);
+    pm.barrier.waiting = 0;
+    pm.barrier.phase = 0;
+
+    pm.barrier.count = nthreads;
+    pm.go = 0;
+    for (int i = 0; i < nthreads; i++) {
+        workers[i].pm = &pm;
+        workers[i].id = i;
+    }
+    int started = 1;
+    while (started < nthreads &&
+           pthread_create(&workers[started].thread, NULL, par_worker, &workers[started]) == 0)
+        started++;
+
+    pthread_mutex_lock(&pm.barrier.mutex);
+    pm.go = started == nthreads ? 1 : -1;
+    pthread_cond_broadcast(&pm.barrier.cond);
+    pthread_mutex_unlock(&pm.barrier.mutex);
+    if (pm.go > 0)
+        par_worker(&workers[0]);   // 调用线程作为0号工作线程
+    for (int i = 1; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    int abort = atomic_load(&pm.abort);
+    int result = pm.go < 0 || abort == 2 ? -2 : abort == 1 ? -1 : 0;
+    if (result == 0) {
+        /* 摘除链表必须串行：把各段的死亡对象拼接到数组开头并逐个摘除 */
+        size_t total = 0;
+        for (int t = 0; t < nthreads; t++) {
+            size_t from = pm.count * t / nthreads;
+            for (size_t i = 0; i < pm.dead[t]; i++) {
+                GCObject* obj = buf[from + i];
+                unlink_object(gc, obj);
+                buf[total++] = obj;
+            }
+        }
+        result = (int)total;
+    }
+    for (int i = 0; i < nthreads; i++) {
+        pthread_mutex_destroy(&pm.stacks[i].lock);
+        free(pm.stacks[i].items);
+    }
+    pthread_mutex_destroy(&pm.barrier.mutex);
+    pthread_cond_destroy(&pm.barrier.cond);
+    free(pm.stacks);
+    free(pm.dead);
+    free(workers);
+    return result;
+}
+
+/* 内部：收集的公共实现。minor 为真时只扫描新生代（gens[GC_YOUNG]），否则扫描两代 */
+static void collect(GC* gc, int minor) {
     // 调用时已经持有写锁（由上层保证）
-    size_t objCount = gc->count;
+    size_t countBefore = gc->count;
+    drain_free_list(gc);
+    size_t objCount = minor ? gc->gens[GC_YOUNG].count : (size_t)gc->count;
     if (objCount == 0) return;
+    double start = now_seconds();
+    uint64_t traceStart = trace_enabled() ? trace_now() : 0;
+    /* cancel 不在开始时清除：收集开始前到达的取消请求（例如停止后台线程时）同样生效，
+     * 在收集完成或被取消后才清除 */
     
-    /* 预分配灰色队列数组，大小为当前对象总数 */
+    /* 预分配数组，大小为本次扫描的对象总数：标记时用作灰色队列（并行时为对象数组），清除时存放死亡对象 */
     GCObject** grey = (GCObject**)malloc(objCount * sizeof(GCObject*));
     if (!grey) {
         // 内存不足，跳过本次收集（比部分标记更安全）
         return;
     }
-    int greySize = 0;
-
-    /* 第一步：重置所有对象为白色，找出根（refCount > 1 的对象） */
-    for (GCObject* obj = gc->head; obj; obj = obj->next) {
-        obj->mark = 0;
-        int rc = atomic_load(&obj->refCount);
-        if (rc > 1) {   // 有外部引用（排除GC自身持有的1）
-            grey[greySize++] = obj;
-            obj->mark = 1;   // 灰色
+    int nthreads = parallel_threads(gc, objCount);
+    int deadSize = nthreads > 1 ? mark_sweep_parallel(gc, minor, grey, nthreads)
+                                : mark_sweep_serial(gc, minor, grey);
+    if (traceStart)
+        trace_event("gc.mark", "gc", traceStart, trace_now() - traceStart, "objects", objCount);
+    if (deadSize < 0) {
+        free(grey);
+        if (deadSize == -1) {
+            atomic_store(&gc->cancel, 0);
+            record_timing(gc, start, objCount, minor, 1);
         }
+        return;
     }
+    atomic_store(&gc->cancel, 0);
 
-    /* 第二步：标记传播 */
-    for (int i = 0; i < greySize; i++) {
-        GCObject* cur = grey[i];
-        for (int j = 0; j < cur->strongSize; j++) {
-            GCObject* ref = cur->strongRefs[j];
-            if (ref && ref->mark == 0) {
-                ref->mark = 1;
-                grey[greySize++] = ref;
-            }
-        }
-        cur->mark = 2;   // 黑色
+    /* 死亡对象进入待清除队列，析构与释放分步进行，停顿不随垃圾量增长 */
+    for (int i = 0; i < deadSize; i++) {
+        GCObject* obj = grey[i];
+        obj->nextFree = NULL;
+        if (gc->sweepTail) gc->sweepTail->nextFree = obj;
+        else gc->sweepHead = obj;
+        gc->sweepTail = obj;
     }
+    gc->sweepCount += deadSize;
+    free(grey);
+    promote_survivors(gc);
+
+    if (!minor) {
+        /* 完整收集的存活量作为下一次完整收集的基准；字节数要等队列清空后才准确（见 gc_sweep） */
+        gc->lastCleanup = gc->count;
+        gc->sweepRebase = 1;
+    }
+    gc->lastFreedObjects = countBefore - gc->count;
+    gc->lastFreedBytes = 0;
+    record_timing(gc, start, objCount, minor, 0);
+    gc_sweep(gc, 0);
+    if (traceStart)
+        trace_event(minor ? "gc.collect_minor" : "gc.collect", "gc", traceStart, trace_now() - traceStart,
+                    "dead", (uint64_t)deadSize);
+}
 
-    /* 第三步：清除白色对象 */
-    GCObject* obj = gc->head;
+/* 内部：释放已析构的对象（必须持有写锁，且待析构队列已空） */
+static void free_swept(GC* gc) {
+    GCObject** small = (GCObject**)malloc(gc->freeCount * sizeof(GCObject*));
+    size_t smallSize = 0;
+    GCObject* obj = gc->freeHead;
     while (obj) {
-        GCObject* next = obj->next;
-        if (obj->mark == 0) {
-            /* 从链表中移除 */
-            if (obj->prev) obj->prev->next = obj->next;
-            else gc->head = obj->next;
-            if (obj->next) obj->next->prev = obj->prev;
-            else gc->tail = obj->prev;
-
-            /* 调用析构函数（如果存在） */
-            if (obj->dtor) {
-                obj->dtor(obj);
-            }
-            
-            /* 释放强引用数组和对象本身 */
-            free(obj->strongRefs);
+        GCObject* next = obj->nextFree;
+        add_object(gc, obj, -1);
+        if (obj->size > SLAB_MAX_SIZE)
             free(obj);
-            gc->count--;
-        }
+        else if (small)
+            small[smallSize++] = obj;   // 小对象按页批量归还
+        else
+            slab_free(obj, obj->size);
         obj = next;
     }
+    slab_free_bulk((void**)small, smallSize);
+    free(small);
+    gc->freeHead = NULL;
+    gc->freeCount = 0;
+}
 
-    free(grey);
-    gc->lastCleanup = gc->count;
+size_t gc_sweep(GC* gc, int all) {
+    size_t bytesBefore = atomic_load(&gc->bytes);
+    uint64_t traceStart = trace_enabled() && gc->sweepHead ? trace_now() : 0;
+    double deadline = (!all && gc->sweepTime > 0) ? now_seconds() + gc->sweepTime : 0;
+    size_t n = 0;
+    while (gc->sweepHead) {
+        if (!all && gc->sweepBudget > 0 && n >= gc->sweepBudget) break;
+        if (deadline > 0 && n > 0 && n % 32 == 0 && now_seconds() >= deadline) break;
+        GCObject* obj = gc->sweepHead;
+        gc->sweepHead = obj->nextFree;
+        if (!gc->sweepHead) gc->sweepTail = NULL;
+        gc->sweepCount--;
+        if (obj->dtor) {
+            obj->dtor(obj);
+            obj->dtor = NULL;
+        }
+        /* 析构函数可能还会 release 同批的其他死亡对象，全部析构完才能释放 */
+        obj->nextFree = gc->freeHead;
+        gc->freeHead = obj;
+        gc->freeCount++;
+        n++;
+    }
+    if (!gc->sweepHead && gc->freeHead)
+        free_swept(gc);
+
+    size_t bytesAfter = atomic_load(&gc->bytes);
+    size_t freed = bytesBefore > bytesAfter ? bytesBefore - bytesAfter : 0;
+    gc->lastFreedBytes += freed;
+    gc->totalFreedBytes += freed;
+    if (!gc->sweepHead && gc->sweepRebase) {
+        gc->lastCleanupBytes = bytesAfter > GC_MIN_TRIGGER_BYTES ? bytesAfter : GC_MIN_TRIGGER_BYTES;
+        gc->sweepRebase = 0;
+    }
+    if (traceStart)
+        trace_event("gc.sweep", "gc", traceStart, trace_now() - traceStart, "objects", n);
+    return gc->sweepCount + gc->freeCount;
+}
+
+void gc_collect(GC* gc) {
+    collect(gc, 0);
+}
+
+void gc_collect_minor(GC* gc) {
+    collect(gc, 1);
+}
+
+void gc_cancel(GC* gc) {
+    atomic_store(&gc->cancel, 1);
+}
+
+void gc_get_stats(GC* gc, GCStats* out) {
+    pthread_rwlock_rdlock(&gc->rwlock);
+    out->objects = gc->count;
+    out->bytes = atomic_load(&gc->bytes);
+    out->youngObjects = gc->gens[GC_YOUNG].count;
+    out->oldObjects = gc->gens[GC_OLD].count;
+    out->pendingSweep = gc->sweepCount + gc->freeCount;
+    for (int i = 0; i < GC_MEM_COUNT; i++)
+        out->memBytes[i] = atomic_load(&gc->memBytes[i]);
+    for (int i = 0; i < GC_MAX_KINDS; i++) {
+        out->kinds[i].objects = atomic_load(&gc->kindObjects[i]);
+        out->kinds[i].bytes = atomic_load(&gc->kindBytes[i]);
+    }
+    out->timing = gc->timing;
+    out->lastFreedObjects = gc->lastFreedObjects;
+    out->lastFreedBytes = gc->lastFreedBytes;
+    out->totalFreedBytes = gc->totalFreedBytes;
+    pthread_rwlock_unlock(&gc->rwlock);
+}
+
+void gc_get_timing(GC* gc, GCTiming* out) {
+    pthread_rwlock_rdlock(&gc->rwlock);
+    *out = gc->timing;
+    pthread_rwlock_unlock(&gc->rwlock);
+}
+
+/* 内部：后台线程的节奏判断（必须持有写锁）。
+ * rate/byteRate 为自上次唤醒以来的对象与字节分配速率（每秒），按下一个间隔结束时的预计值判断是否到达阈值；
+ * 设置了目标停顿时，再用上次收集的单对象耗时估算本次停顿，超出前提前收集 */
+static int should_collect_paced(GC* gc, double rate, double byteRate) {
+    if (!gc->enabled || gc->count == 0) return 0;
+    if (over_threshold(gc, rate * gc->bgInterval, byteRate * gc->bgInterval)) return 1;
+    if (gc->bgTargetPause > 0 && gc->timing.lastObjects > 0 &&
+        (size_t)gc->count > gc->lastCleanup) {
+        double perObject = gc->timing.lastPause / gc->timing.lastObjects;
+        if (gc->count * perObject >= gc->bgTargetPause) return 1;
+    }
+    return 0;
+}
+
+/* 孤立堆的回收线程的唤醒间隔（秒） */
+#define GC_ORPHAN_INTERVAL 1.0
+
+/* 内部：回收全部垃圾，包括析构时才降到基线的叶子对象（必须持有写锁）。返回堆是否已空 */
+static int reap_all(GC* gc) {
+    gc_collect(gc);
+    gc_sweep(gc, 1);
+    while (atomic_load(&gc->freeList))
+        drain_free_list(gc);
+    return gc->count == 0 && !gc->sweepHead && !gc->freeHead;
+}
+
+static void* background_main(void* arg) {
+    GC* gc = (GC*)arg;
+    double lastTime = now_seconds();
+    int lastCount = gc_count(gc);
+    double lastBytes = (double)atomic_load(&gc->bytes);
+
+    pthread_mutex_lock(&gc->bgMutex);
+    while (!gc->bgStop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        double secs = deadline.tv_nsec / 1e9 + gc->bgInterval;
+        deadline.tv_sec += (time_t)secs;
+        deadline.tv_nsec = (long)((secs - (time_t)secs) * 1e9);
+        pthread_cond_timedwait(&gc->bgCond, &gc->bgMutex, &deadline);
+        if (gc->bgStop) break;
+        pthread_mutex_unlock(&gc->bgMutex);
+
+        pthread_rwlock_wrlock(&gc->rwlock);
+        if (gc->orphan) {
+            /* 没有句柄后不再有新的引用者，每次唤醒都完整收集，堆空后由本线程销毁 */
+            int empty = reap_all(gc);
+            pthread_rwlock_unlock(&gc->rwlock);
+            if (empty) {
+                heap_destroy(gc);
+                return NULL;
+            }
+            pthread_mutex_lock(&gc->bgMutex);
+            continue;
+        }
+        double now = now_seconds();
+        double elapsed = now - lastTime;
+        double bytes = (double)atomic_load(&gc->bytes);
+        double rate = elapsed > 0 ? (gc->count - lastCount) / elapsed : 0;
+        double byteRate = elapsed > 0 ? (bytes - lastBytes) / elapsed : 0;
+        if (rate < 0) rate = 0;
+        if (byteRate < 0) byteRate = 0;
+        int running = gc->bgRunning == 1;   // 正在停止时不再开始新的收集
+        if (running && should_collect_paced(gc, rate, byteRate))
+            gc_collect(gc);
+        else if (running && gc->enabled && young_over_limit(gc))
+            gc_collect_minor(gc);
+        /* 按预算分步清除，每步之间释放写锁让其他线程运行 */
+        while (gc_sweep(gc, 0) > 0 && gc->bgRunning == 1) {
+            pthread_rwlock_unlock(&gc->rwlock);
+            sched_yield();
+            pthread_rwlock_wrlock(&gc->rwlock);
+        }
+        lastTime = now_seconds();
+        lastCount = gc->count;
+        lastBytes = (double)atomic_load(&gc->bytes);
+        pthread_rwlock_unlock(&gc->rwlock);
+
+        pthread_mutex_lock(&gc->bgMutex);
+    }
+    pthread_mutex_unlock(&gc->bgMutex);
+    return NULL;
+}
+
+int gc_start_background(GC* gc, double interval, double target_pause) {
+    pthread_rwlock_wrlock(&gc->rwlock);
+    if (gc->bgRunning) {
+        pthread_rwlock_unlock(&gc->rwlock);
+        return 0;
+    }
+    gc->bgInterval = interval > 0.001 ? interval : 0.001;   // 最小间隔，避免忙等
+    gc->bgTargetPause = target_pause > 0 ? target_pause : 0;
+    gc->bgStop = 0;   // 此前的线程已被 join，无并发读者
+    if (pthread_create(&gc->bgThread, NULL, background_main, gc) != 0) {
+        pthread_rwlock_unlock(&gc->rwlock);
+        return 0;
+    }
+    gc->bgRunning = 1;
+    pthread_rwlock_unlock(&gc->rwlock);
+    return 1;
+}
+
+void gc_stop_background(GC* gc) {
+    /* 先取消再取写锁：后台线程若正持有写锁收集，取消后尽快放开；
+     * 取消请求保留到下一次收集结束，不会在两次收集之间丢失 */
+    gc_cancel(gc);
+    pthread_rwlock_wrlock(&gc->rwlock);
+    if (gc->bgRunning != 1) {
+        atomic_store(&gc->cancel, 0);   // 持有写锁，没有收集在进行
+        pthread_rwlock_unlock(&gc->rwlock);
+        return;
+    }
+    gc->bgRunning = 2;   // 正在停止：gc_create 恢复内联收集，后台线程不再开始收集，其他 start/stop 调用直接返回
+    pthread_t thread = gc->bgThread;
+    pthread_rwlock_unlock(&gc->rwlock);
+
+    pthread_mutex_lock(&gc->bgMutex);
+    gc->bgStop = 1;
+    pthread_cond_signal(&gc->bgCond);
+    pthread_mutex_unlock(&gc->bgMutex);
+    pthread_join(thread, NULL);
+
+    pthread_rwlock_wrlock(&gc->rwlock);
+    gc->bgRunning = 0;
+    atomic_store(&gc->cancel, 0);   // 没有被任何收集消耗的取消请求不留给之后的收集
+    pthread_rwlock_unlock(&gc->rwlock);
+}
+
+void gc_heap_retain(GC* gc) {
+    if (gc != gc_instance())
+        atomic_fetch_add(&gc->handles, 1);
+}
+
+/* 内部：释放最后一个句柄后的回收线程（已分离）。停止后台线程并完整收集一次，
+ * 堆已空则销毁，否则留下来作为孤立堆的后台线程，直到最后一个对象被回收 */
+static void* heap_release_main(void* arg) {
+    GC* gc = (GC*)arg;
+    gc_stop_background(gc);
+    pthread_rwlock_wrlock(&gc->rwlock);
+    int empty = reap_all(gc);
+    if (!empty) {
+        gc->orphan = 1;
+        gc->bgInterval = GC_ORPHAN_INTERVAL;
+        gc->bgTargetPause = 0;
+        gc->bgStop = 0;
+        gc->bgThread = pthread_self();
+        gc->bgRunning = 1;   // gc_create 不再内联收集，只唤醒本线程
+    }
+    pthread_rwlock_unlock(&gc->rwlock);
+    if (empty) {
+        heap_destroy(gc);
+        return NULL;
+    }
+    return background_main(gc);
+}
+
+void gc_heap_release(GC* gc) {
+    if (gc == gc_instance() || atomic_fetch_sub(&gc->handles, 1) != 1) return;
+    /* 不在调用线程里加锁：调用者可能正持有这个堆的锁（例如 Lua 终结器在 stored_push 分配时运行） */
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, heap_release_main, gc) == 0)
+        pthread_detach(thread);
+    /* 创建线程失败时堆保留到进程结束 */
+}
+
+int gc_background_running(GC* gc) {
+    pthread_rwlock_rdlock(&gc->rwlock);
+    int ret = gc->bgRunning == 1;
+    pthread_rwlock_unlock(&gc->rwlock);
+    return ret;
 }
 
 void gc_pause(GC* gc) {
@@ -228,6 +1031,48 @@ double gc_get_step(GC* gc) {
     return ret;
 }
 
+void gc_set_young_limit(GC* gc, size_t limit) {
+    pthread_rwlock_wrlock(&gc->rwlock);
+    gc->youngLimit = limit;
+    pthread_rwlock_unlock(&gc->rwlock);
+}
+
+size_t gc_get_young_limit(GC* gc) {
+    pthread_rwlock_rdlock(&gc->rwlock);
+    size_t ret = gc->youngLimit;
+    pthread_rwlock_unlock(&gc->rwlock);
+    return ret;
+}
+
+void gc_set_threads(GC* gc, int threads) {
+    pthread_rwlock_wrlock(&gc->rwlock);
+    if (threads < 1) threads = 1;
+    if (threads > GC_MAX_THREADS) threads = GC_MAX_THREADS;
+    gc->threads = threads;
+    pthread_rwlock_unlock(&gc->rwlock);
+}
+
+int gc_get_threads(GC* gc) {
+    pthread_rwlock_rdlock(&gc->rwlock);
+    int ret = gc->threads;
+    pthread_rwlock_unlock(&gc->rwlock);
+    return ret;
+}
+
+void gc_set_sweep_budget(GC* gc, size_t objects, double seconds) {
+    pthread_rwlock_wrlock(&gc->rwlock);
+    gc->sweepBudget = objects;
+    gc->sweepTime = seconds > 0 ? seconds : 0;
+    pthread_rwlock_unlock(&gc->rwlock);
+}
+
+void gc_get_sweep_budget(GC* gc, size_t* objects, double* seconds) {
+    pthread_rwlock_rdlock(&gc->rwlock);
+    if (objects) *objects = gc->sweepBudget;
+    if (seconds) *seconds = gc->sweepTime;
+    pthread_rwlock_unlock(&gc->rwlock);
+}
+
 int gc_count(GC* gc) {
     pthread_rwlock_rdlock(&gc->rwlock);
     int ret = gc->count;
@@ -5,51 +5,236 @@
 #include <pthread.h>
 #include <stdatomic.h>
 
+/* 字节触发阈值的下限：堆很小时不因字节增长频繁收集 */
+#define GC_MIN_TRIGGER_BYTES (1 << 20)
+
+/* 分代：新对象进入新生代，经历 GC_PROMOTE_AGE 次收集仍存活后晋升老年代 */
+#define GC_YOUNG 0
+#define GC_OLD 1
+#define GC_PROMOTE_AGE 2
+#define GC_DEFAULT_YOUNG_LIMIT 4096   /* 新生代对象数达到该值时触发次要收集 */
+
+/* 并行收集的线程数上限；每个线程至少分到 GC_PARALLEL_MIN_PER_THREAD 个对象，否则减少线程数 */
+#define GC_MAX_THREADS 256
+#define GC_PARALLEL_MIN_PER_THREAD 4096
+
+/* 每步清除默认最多析构的对象数 */
+#define GC_DEFAULT_SWEEP_BUDGET 1024
+
 /* 辅助宏：获取用户数据起始地址 */
 #define gc_userdata(obj) ((void*)((char*)(obj) + sizeof(GCObject)))
 
+struct GCObject;
+struct GC;
+
+/* 遍历回调：trace 对对象持有的每个强引用调用一次 */
+typedef void (*GCVisitor)(struct GCObject* ref, void* ud);
+
+/* 对象种类上限。种类由对象所属模块定义（StoredObject 使用 StoredType），用于按类型统计 */
+#define GC_MAX_KINDS 32
+
+/* 对象附带内存的分类（对象本身计入 GC_MEM_OBJECT） */
+typedef enum {
+    GC_MEM_OBJECT,                  /* 对象本身（含对象头） */
+    GC_MEM_STRING,                  /* 字符串内容 */
+    GC_MEM_TABLE,                   /* 表的键值数组 */
+    GC_MEM_BYTECODE,                /* 函数字节码与 upvalue 数组 */
+    GC_MEM_ARRAY,                   /* 数值数组的元素 */
+    GC_MEM_OTHER,
+    GC_MEM_COUNT
+} GCMemKind;
+
+/* 对象标志 */
+#define GC_FLAG_LEAF 0x1            /* 叶子对象（没有出边）：引用计数降到GC基线时立即回收 */
+
 /* 对象头结构 */
 typedef struct GCObject {
-    atomic_int refCount;            /* 外部引用计数（原子类型） */
-    int mark;                       /* 标记颜色：0白色，1灰色，2黑色 */
-    int strongCapacity;             /* 强引用数组容量 */
-    int strongSize;                 /* 当前强引用数量 */
-    struct GCObject** strongRefs;   /* 强引用动态数组 */
+    atomic_int refCount;            /* 引用计数（原子类型），包含GC自身的1个和所有强引用边 */
+    atomic_int mark;                /* 标记颜色：0白色，1灰色，2黑色（并行收集时原子访问） */
+    int flags;                      /* GC_FLAG_* 标志，由对象类型在创建后设置 */
+    atomic_int gcRefs;              /* 收集时的临时计数：扣除内部边后的外部引用数 */
+    int gen;                        /* 所在代：GC_YOUNG 或 GC_OLD */
+    int age;                        /* 在新生代中经历的收集次数 */
+    atomic_int pending;             /* 已在待释放链表中，或已被判定为垃圾 */
+    struct GCObject* nextFree;      /* 待释放链表或待清除队列的节点 */
+    size_t size;                    /* 分配大小（含对象头），释放时决定归还 slab 还是 free */
+    int kind;                       /* 对象种类（0..GC_MAX_KINDS-1），见 gc_set_kind */
+    struct GC* gc;                  /* 所属的堆 */
     struct GCObject *prev, *next;   /* 双向链表节点 */
     void (*dtor)(struct GCObject*);   // 析构函数，在对象被回收前调用
+    void (*trace)(struct GCObject*, GCVisitor, void*);   // 遍历强引用，NULL 表示没有出边
 } GCObject;
 
-/* GC全局结构 */
+/* 收集耗时统计（单位：秒） */
+typedef struct GCTiming {
+    size_t cycles;                  /* 完成的收集次数 */
+    size_t cancelled;               /* 被取消的收集次数 */
+    size_t minorCycles;             /* 完成的次要收集（只扫描新生代）次数，不计入 cycles */
+    size_t lastObjects;             /* 最近一次完整收集扫描的对象数 */
+    double lastPause;               /* 最近一次收集耗时 */
+    double totalPause;              /* 累计收集耗时 */
+    double maxPause;                /* 单次最长收集耗时 */
+} GCTiming;
+
+/* 单个种类的存活统计 */
+typedef struct GCKindStats {
+    size_t objects;
+    size_t bytes;                   /* 对象本身加上记入该种类的附带内存 */
+} GCKindStats;
+
+/* 堆统计快照 */
+typedef struct GCStats {
+    size_t objects;                 /* 存活对象数 */
+    size_t bytes;                   /* 存活字节数（对象与附带内存） */
+    size_t youngObjects;            /* 新生代对象数 */
+    size_t oldObjects;              /* 老年代对象数 */
+    size_t pendingSweep;            /* 已判定为垃圾、尚未释放的对象数（不计入 objects，字节仍计入 bytes） */
+    size_t memBytes[GC_MEM_COUNT];  /* 按内存分类的字节数 */
+    GCKindStats kinds[GC_MAX_KINDS];
+    GCTiming timing;
+    size_t lastFreedObjects;        /* 最近一次收集判定为垃圾的对象数 */
+    size_t lastFreedBytes;          /* 最近一次收集开始以来清除释放的字节数 */
+    size_t totalFreedBytes;         /* 收集累计释放的字节数 */
+} GCStats;
+
+/* 一代对象的链表 */
+typedef struct GCList {
+    struct GCObject *head, *tail;
+    size_t count;
+} GCList;
+
+/* GC堆结构。gc_instance() 返回默认堆，gc_new() 创建独立的堆：
+ * 每个堆有自己的锁、对象链表、触发节奏、后台线程和统计，一个堆的收集不会阻塞其他堆 */
 typedef struct GC {
-    struct GCObject *head, *tail;   /* 对象链表 */
+    GCList gens[2];                 /* 对象链表：gens[GC_YOUNG] 新生代，gens[GC_OLD] 老年代 */
     int count;                      /* 对象总数 */
+    size_t youngLimit;              /* 新生代对象数达到该值时做次要收集，0 表示总是完整收集 */
+    int threads;                    /* 收集使用的线程数（含调用线程），1 表示单线程 */
     int enabled;                    /* 是否允许自动收集 */
     double step;                    /* 触发阈值系数 */
     size_t lastCleanup;             /* 上次清理后的对象数 */
+    size_t lastCleanupBytes;        /* 上次清理后的字节数（不低于 GC_MIN_TRIGGER_BYTES） */
     pthread_rwlock_t rwlock;        /* 读写锁：读锁用于引用计数，写锁用于修改结构 */
+    _Atomic(GCObject*) freeList;    /* 引用计数降到基线的叶子对象（无锁栈），持有写锁时释放 */
+    GCTiming timing;                /* 收集耗时统计（持有写锁时更新） */
+    size_t lastFreedObjects;        /* 以下三项持有写锁时更新 */
+    size_t lastFreedBytes;
+    size_t totalFreedBytes;
+
+    /* 增量清除（持有写锁时访问）：死亡对象先进入待析构队列，每步析构一批；
+     * 队列清空后再统一释放，因为析构函数可能 release 同批的其他死亡对象 */
+    struct GCObject *sweepHead, *sweepTail;   /* 待析构队列（经 nextFree 串联） */
+    size_t sweepCount;
+    struct GCObject* freeHead;      /* 已析构、待释放的对象 */
+    size_t freeCount;
+    size_t sweepBudget;             /* 每步最多析构的对象数，0 表示不限 */
+    double sweepTime;               /* 每步的时间预算（秒），0 表示不限 */
+    int sweepRebase;                /* 完整收集后待队列清空时更新 lastCleanupBytes */
+
+    /* 内存统计（原子计数，分配/释放路径无需加锁；负增量按模运算累加） */
+    atomic_size_t bytes;
+    atomic_size_t memBytes[GC_MEM_COUNT];
+    atomic_size_t kindObjects[GC_MAX_KINDS];
+    atomic_size_t kindBytes[GC_MAX_KINDS];
+    atomic_int cancel;              /* 置位时中止正在进行的收集 */
+
+    /* 后台收集线程（gc_start_background 启动后，gc_create 不再内联收集） */
+    int bgRunning;                  /* 0未运行，1运行中，2正在停止（持有写锁时修改） */
+    int bgStop;                     /* 请求后台线程退出（受 bgMutex 保护） */
+    double bgInterval;              /* 唤醒间隔（秒） */
+    double bgTargetPause;           /* 目标停顿（秒），0 表示不限制 */
+    pthread_t bgThread;
+    pthread_mutex_t bgMutex;
+    pthread_cond_t bgCond;
+
+    /* 生命周期（只用于 gc_new 创建的堆） */
+    atomic_int handles;             /* 句柄引用数，降到0后堆中的对象全部回收时销毁 */
+    int orphan;                     /* 句柄已全部释放，仍有对象存活，由回收线程收集（持有写锁时修改） */
 } GC;
 
-/* 全局单例访问 */
+/* 默认堆（全局单例） */
 GC* gc_instance(void);
 
-/* 创建新对象，返回句柄。data_size 为用户数据大小，将附加在对象后 */
+/* 创建一个独立的堆，参数与默认堆相同，失败返回NULL。返回时持有一个句柄引用（见 gc_heap_release）。
+ * 对象可以引用其他堆的对象：跨堆的边计入目标的引用计数，目标堆收集时看不到引用者，
+ * 目标因此被当作根，引用者释放前不会被回收；trace 到的其他堆对象被收集器跳过。
+ * 代价是跨堆的环无法回收，应避免让两个堆互相引用 */
+GC* gc_new(void);
+
+/* 增加/释放 gc_new 创建的堆的句柄引用，对默认堆无效。释放最后一个句柄后，由一个分离的线程停止后台线程
+ * 并做一次完整收集：堆已空时销毁；仍有对象被外部引用时（每个存活对象都让堆保持存活），该线程定期收集，
+ * 最后一个对象回收后销毁堆。释放最后一个句柄后不能再通过 GC* 调用任何 gc_ 函数（对堆中仍存活对象的操作不受影响）。
+ * gc_heap_release 自身从不获取堆锁，收集都在那个线程中进行；因此可以在持有堆锁时调用（例如 Lua 终结器
+ * 在 stored_push 持有读锁分配时运行），但不能在持有锁的同时等待堆被销毁 */
+void gc_heap_retain(GC* gc);
+void gc_heap_release(GC* gc);
+
+/* 在 gc 堆中创建新对象，返回句柄。data_size 为用户数据大小，将附加在对象后并清零
+ * （trace 可能在调用者初始化完成前被调用，清零的数据必须表示“没有出边”）。
+ * 新对象的引用计数为2：GC自身持有1个，调用者持有1个（用完须 gc_release） */
 GCObject* gc_create(GC* gc, size_t data_size);
 
-/* 增加外部引用计数（例如Lua持有） */
+/* 设置对象种类，须在 gc_account 记录附带内存之前调用（只迁移对象本身的计数） */
+void gc_set_kind(GCObject* obj, int kind);
+
+/* 记录对象附带内存的分配（delta > 0）或释放（delta < 0），计入总字节数、分类和对象种类。
+ * 分配与释放须使用相同的分类和对象 */
+void gc_account(GCObject* obj, GCMemKind mem, ptrdiff_t delta);
+
+/* 获取堆统计快照 */
+void gc_get_stats(GC* gc, GCStats* out);
+
+/* 增加外部引用计数（例如Lua持有）。从容器中取出调用者尚未持有的对象并增加引用时，
+ * 必须在 gc_mutate_begin 内调用：收集不持有容器的锁，试删除读引用计数的中途不能出现新引用 */
 void gc_retain(GCObject* obj);
 
-/* 减少外部引用计数 */
+/* 减少外部引用计数。叶子对象降到GC基线（1）时进入待释放链表，
+ * 在下一次 gc_create / gc_collect 时释放，无需等待完整的标记清除 */
 void gc_release(GCObject* obj);
 
-/* 添加从 from 到 to 的强引用 */
-void gc_add_reference(GCObject* from, GCObject* to);
-
-/* 移除从 from 到 to 的强引用 */
-void gc_remove_reference(GCObject* from, GCObject* to);
+/* 修改 trace 会遍历的字段前后调用，gc 为被修改对象所属的堆。持有共享读锁：修改者之间互不阻塞，只与收集互斥。
+ * 强引用本身用 gc_retain/gc_release 计数；锁顺序为先对象自身的锁，再 gc_mutate_begin */
+void gc_mutate_begin(GC* gc);
+void gc_mutate_end(GC* gc);
 
-/* 执行一次垃圾收集（三色标记清除） */
+/* 执行一次完整垃圾收集（三色标记清除，扫描两代），调用者必须持有 gc->rwlock 写锁。
+ * 根由试删除确定：引用计数扣除GC基线和所有 trace 到的内部强引用后仍大于0的对象，
+ * 因此只被垃圾对象引用的环也能回收 */
 void gc_collect(GC* gc);
 
+/* 执行一次次要收集，只扫描新生代，调用者必须持有 gc->rwlock 写锁。
+ * 试删除只扣除新生代内部的边，老年代指向新生代的边保留在引用计数中，使被引用者成为根，
+ * 因此引用计数本身就是记忆集，修改引用的路径无需额外记录。
+ * 只被已死老年代对象引用的新生代对象要到下一次完整收集才回收 */
+void gc_collect_minor(GC* gc);
+
+/* 处理待清除队列，调用者必须持有 gc->rwlock 写锁。all 为0时按预算（对象数与时间，先到者为准）
+ * 处理一步，否则全部处理。返回仍待清除的对象数。
+ * 收集只负责标记和摘除死亡对象，随后调用一步；其余由之后的 gc_create 或后台线程分步完成 */
+size_t gc_sweep(GC* gc, int all);
+
+/* 设置/获取每步清除的预算：最多析构 objects 个对象（0 不限），最多耗时 seconds 秒（0 不限） */
+void gc_set_sweep_budget(GC* gc, size_t objects, double seconds);
+void gc_get_sweep_budget(GC* gc, size_t* objects, double* seconds);
+
+/* 请求中止正在进行的收集（任意线程可调用，无需持锁）。没有收集在进行时，请求保留到下一次收集，
+ * 该次收集在标记开始时即中止 */
+void gc_cancel(GC* gc);
+
+/* 获取收集耗时统计 */
+void gc_get_timing(GC* gc, GCTiming* out);
+
+/* 启动后台收集线程：每 interval 秒按分配速率决定是否收集；
+ * target_pause > 0 时，按上次收集的单对象耗时估算停顿，堆增长到预计超出该停顿前提前收集。
+ * 成功返回1，已在运行或创建线程失败返回0 */
+int gc_start_background(GC* gc, double interval, double target_pause);
+
+/* 停止后台收集线程并等待其退出，之后恢复 gc_create 内联收集 */
+void gc_stop_background(GC* gc);
+
+/* 后台收集线程是否在运行 */
+int gc_background_running(GC* gc);
+
 /* 暂停自动收集（create时不再触发collect） */
 void gc_pause(GC* gc);
 
@@ -59,12 +244,22 @@ void gc_resume(GC* gc);
 /* 获取当前是否允许自动收集 */
 int gc_enabled(GC* gc);
 
-/* 设置触发收集的阈值系数，例如 2.0 表示对象数达到上次清理后对象数的2倍时触发 */
+/* 设置触发收集的阈值系数，例如 2.0 表示对象数或字节数达到上次清理后的2倍时触发 */
 void gc_set_step(GC* gc, double step);
 
 /* 获取当前阈值系数 */
 double gc_get_step(GC* gc);
 
+/* 设置/获取触发次要收集的新生代对象数，0 表示关闭分代（总是完整收集） */
+void gc_set_young_limit(GC* gc, size_t limit);
+size_t gc_get_young_limit(GC* gc);
+
+/* 设置/获取收集使用的线程数（1..GC_MAX_THREADS，含调用收集的线程）。
+ * 大于1时试删除、标记（每线程一个灰色栈，空闲时互相窃取）和查找死亡对象都并行执行，
+ * 只有摘除链表是串行的；对象太少时自动减少线程数 */
+void gc_set_threads(GC* gc, int threads);
+int gc_get_threads(GC* gc);
+
 /* 返回当前管理的对象总数 */
 int gc_count(GC* gc);
 
@@ -1,21 +1,31 @@
 #include "XShare.h"
+#include "trace.h"
 #include "lauxlib.h"
 
-// GC 相关 Lua 函数
+// GC 相关 Lua 函数（upvalue 为所控制的堆，见 push_gc_table）
+// xshare.gc.collect(["full" | "minor"])
 static int l_gc_collect(lua_State* L) {
-    GC* gc = gc_instance();
-    gc_collect(gc);
+    static const char* const modes[] = { "full", "minor", NULL };
+    GC* gc = shared_table_upvalue_heap(L);
+    int minor = luaL_checkoption(L, 1, "full", modes);
+    pthread_rwlock_wrlock(&gc->rwlock);   // gc_collect 要求调用者持有写锁
+    if (minor)
+        gc_collect_minor(gc);
+    else
+        gc_collect(gc);
+    gc_sweep(gc, 1);   // 手动收集时立即完成清除
+    pthread_rwlock_unlock(&gc->rwlock);
     return 0;
 }
 
 static int l_gc_count(lua_State* L) {
-    GC* gc = gc_instance();
+    GC* gc = shared_table_upvalue_heap(L);
     lua_pushinteger(L, gc_count(gc));
     return 1;
 }
 
 static int l_gc_step(lua_State* L) {
-    GC* gc = gc_instance();
+    GC* gc = shared_table_upvalue_heap(L);
     double old = gc_get_step(gc);
     if (lua_gettop(L) >= 1) {
         double new_step = luaL_checknumber(L, 1);
@@ -25,24 +35,354 @@ static int l_gc_step(lua_State* L) {
     return 1;
 }
 
+// xshare.gc.young_limit([n])，返回旧值
+static int l_gc_young_limit(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    size_t old = gc_get_young_limit(gc);
+    if (lua_gettop(L) >= 1) {
+        lua_Integer n = luaL_checkinteger(L, 1);
+        gc_set_young_limit(gc, n > 0 ? (size_t)n : 0);
+    }
+    lua_pushinteger(L, old);
+    return 1;
+}
+
+// xshare.gc.threads([n])，返回旧值
+static int l_gc_threads(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    int old = gc_get_threads(gc);
+    if (lua_gettop(L) >= 1)
+        gc_set_threads(gc, (int)luaL_checkinteger(L, 1));
+    lua_pushinteger(L, old);
+    return 1;
+}
+
+// xshare.gc.sweep_budget([objects[, seconds]])，返回旧的 objects, seconds
+static int l_gc_sweep_budget(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    size_t objects;
+    double seconds;
+    gc_get_sweep_budget(gc, &objects, &seconds);
+    if (lua_gettop(L) >= 1) {
+        lua_Integer n = luaL_checkinteger(L, 1);
+        gc_set_sweep_budget(gc, n > 0 ? (size_t)n : 0, luaL_optnumber(L, 2, 0));
+    }
+    lua_pushinteger(L, objects);
+    lua_pushnumber(L, seconds);
+    return 2;
+}
+
 static int l_gc_pause(lua_State* L) {
-    GC* gc = gc_instance();
+    GC* gc = shared_table_upvalue_heap(L);
     gc_pause(gc);
     return 0;
 }
 
 static int l_gc_resume(lua_State* L) {
-    GC* gc = gc_instance();
+    GC* gc = shared_table_upvalue_heap(L);
     gc_resume(gc);
     return 0;
 }
 
 static int l_gc_enabled(lua_State* L) {
-    GC* gc = gc_instance();
+    GC* gc = shared_table_upvalue_heap(L);
     lua_pushboolean(L, gc_enabled(gc));
     return 1;
 }
 
+// xshare.gc.start_background({interval = 秒, target_pause = 秒})
+static int l_gc_start_background(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    double interval = 0.1;
+    double target_pause = 0;
+    if (!lua_isnoneornil(L, 1)) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        lua_getfield(L, 1, "interval");
+        if (!lua_isnil(L, -1)) interval = luaL_checknumber(L, -1);
+        lua_getfield(L, 1, "target_pause");
+        if (!lua_isnil(L, -1)) target_pause = luaL_checknumber(L, -1);
+        lua_pop(L, 2);
+    }
+    lua_pushboolean(L, gc_start_background(gc, interval, target_pause));
+    return 1;
+}
+
+static int l_gc_stop_background(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    gc_stop_background(gc);
+    return 0;
+}
+
+static int l_gc_cancel(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    gc_cancel(gc);
+    return 0;
+}
+
+static int l_gc_timing(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    GCTiming t;
+    gc_get_timing(gc, &t);
+    lua_newtable(L);
+    lua_pushinteger(L, t.cycles);      lua_setfield(L, -2, "cycles");
+    lua_pushinteger(L, t.cancelled);   lua_setfield(L, -2, "cancelled");
+    lua_pushinteger(L, t.minorCycles); lua_setfield(L, -2, "minor_cycles");
+    lua_pushnumber(L, t.lastPause);    lua_setfield(L, -2, "last_pause");
+    lua_pushnumber(L, t.totalPause);   lua_setfield(L, -2, "total_pause");
+    lua_pushnumber(L, t.maxPause);     lua_setfield(L, -2, "max_pause");
+    lua_pushboolean(L, gc_background_running(gc)); lua_setfield(L, -2, "background");
+    return 1;
+}
+
+// 对象种类名称（下标与 StoredType / SHARED_TABLE_KIND 对应）
+static const char* const kind_names[GC_MAX_KINDS] = {
+    [STORED_NIL] = "nil",
+    [STORED_BOOLEAN] = "boolean",
+    [STORED_NUMBER] = "number",
+    [STORED_INTEGER] = "integer",
+    [STORED_STRING] = "string",
+    [STORED_LIGHTUSERDATA] = "lightuserdata",
+    [STORED_CFUNCTION] = "cfunction",
+    [STORED_FUNCTION] = "function",
+    [STORED_TABLE_COPY] = "table_copy",
+    [STORED_SHARED_TABLE] = "shared_table_ref",
+    [STORED_USERDATA] = "userdata_ref",
+    [SHARED_TABLE_KIND] = "shared_table",
+    [SHARED_ARRAY_KIND] = "shared_array",
+    [SHARED_SCHEMA_KIND] = "shared_struct",
+    [SHARED_RECORD_KIND] = "shared_record",
+    [SHARED_LRU_KIND] = "shared_lru",
+    [SHARED_PQUEUE_KIND] = "shared_pqueue",
+};
+
+static const char* const mem_names[GC_MEM_COUNT] = {
+    [GC_MEM_OBJECT] = "object",
+    [GC_MEM_STRING] = "string",
+    [GC_MEM_TABLE] = "table",
+    [GC_MEM_BYTECODE] = "bytecode",
+    [GC_MEM_ARRAY] = "array",
+    [GC_MEM_OTHER] = "other",
+};
+
+// xshare.gc.stats()
+static int l_gc_stats(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    GCStats st;
+    gc_get_stats(gc, &st);
+    lua_newtable(L);
+    lua_pushinteger(L, st.objects);               lua_setfield(L, -2, "objects");
+    lua_pushinteger(L, st.bytes);                 lua_setfield(L, -2, "bytes");
+    lua_pushinteger(L, st.youngObjects);          lua_setfield(L, -2, "young");
+    lua_pushinteger(L, st.oldObjects);            lua_setfield(L, -2, "old");
+    lua_pushinteger(L, st.pendingSweep);          lua_setfield(L, -2, "pending_sweep");
+    lua_pushinteger(L, st.timing.cycles);         lua_setfield(L, -2, "cycles");
+    lua_pushinteger(L, st.timing.cancelled);      lua_setfield(L, -2, "cancelled");
+    lua_pushinteger(L, st.timing.minorCycles);    lua_setfield(L, -2, "minor_cycles");
+    lua_pushnumber(L, st.timing.lastPause);       lua_setfield(L, -2, "last_pause");
+    lua_pushnumber(L, st.timing.totalPause);      lua_setfield(L, -2, "total_pause");
+    lua_pushnumber(L, st.timing.maxPause);        lua_setfield(L, -2, "max_pause");
+    lua_pushinteger(L, st.lastFreedObjects);      lua_setfield(L, -2, "last_freed_objects");
+    lua_pushinteger(L, st.lastFreedBytes);        lua_setfield(L, -2, "last_freed_bytes");
+    lua_pushinteger(L, st.totalFreedBytes);       lua_setfield(L, -2, "total_freed_bytes");
+
+    lua_newtable(L);   // memory
+    for (int i = 0; i < GC_MEM_COUNT; i++) {
+        lua_pushinteger(L, st.memBytes[i]);
+        lua_setfield(L, -2, mem_names[i]);
+    }
+    lua_setfield(L, -2, "memory");
+
+    lua_newtable(L);   // types
+    for (int i = 0; i < GC_MAX_KINDS; i++) {
+        if (!kind_names[i] || st.kinds[i].objects == 0) continue;
+        lua_newtable(L);
+        lua_pushinteger(L, st.kinds[i].objects); lua_setfield(L, -2, "objects");
+        lua_pushinteger(L, st.kinds[i].bytes);   lua_setfield(L, -2, "bytes");
+        lua_setfield(L, -2, kind_names[i]);
+    }
+    lua_setfield(L, -2, "types");
+
+    size_t prototypes, bytes, references;   // 函数注册表是进程级的，各堆返回相同的值
+    stored_function_stats(&prototypes, &bytes, &references);
+    lua_newtable(L);
+    lua_pushinteger(L, prototypes);   lua_setfield(L, -2, "prototypes");
+    lua_pushinteger(L, bytes);        lua_setfield(L, -2, "bytes");
+    lua_pushinteger(L, references);   lua_setfield(L, -2, "references");
+    lua_setfield(L, -2, "functions");
+    return 1;
+}
+
+// 压入一个堆的 gc 控制表，所有函数以栈顶的值（堆句柄或默认堆的轻量 userdata）作为 upvalue，并弹出该值
+static void push_gc_table(lua_State* L) {
+    static const luaL_Reg funcs[] = {
+        {"collect", l_gc_collect},
+        {"count", l_gc_count},
+        {"step", l_gc_step},
+        {"young_limit", l_gc_young_limit},
+        {"threads", l_gc_threads},
+        {"sweep_budget", l_gc_sweep_budget},
+        {"pause", l_gc_pause},
+        {"resume", l_gc_resume},
+        {"enabled", l_gc_enabled},
+        {"start_background", l_gc_start_background},
+        {"stop_background", l_gc_stop_background},
+        {"cancel", l_gc_cancel},
+        {"timing", l_gc_timing},
+        {"stats", l_gc_stats},
+        {NULL, NULL}
+    };
+    lua_newtable(L);
+    lua_insert(L, -2);
+    luaL_setfuncs(L, funcs, 1);
+}
+
+// 追踪相关 Lua 函数
+// xshare.trace.start([threshold_us])：加锁等待和值传递超过阈值（微秒）才记录
+static int l_trace_start(lua_State* L) {
+    lua_Number us = luaL_optnumber(L, 1, 0);
+    if (us < 0) return luaL_argerror(L, 1, "threshold must be non-negative");
+    trace_start((uint64_t)(us * 1000));
+    return 0;
+}
+
+static int l_trace_stop(lua_State* L) {
+    (void)L;
+    trace_stop();
+    return 0;
+}
+
+static int l_trace_enabled(lua_State* L) {
+    lua_pushboolean(L, trace_enabled());
+    return 1;
+}
+
+// xshare.trace.dump(path) -> 事件数 | nil, 错误信息
+static int l_trace_dump(lua_State* L) {
+    const char* path = luaL_checkstring(L, 1);
+    long n = trace_dump(path);
+    if (n < 0) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cannot write trace to %s", path);
+        return 2;
+    }
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+static int l_trace_clear(lua_State* L) {
+    (void)L;
+    trace_clear();
+    return 0;
+}
+
+static void push_trace_table(lua_State* L) {
+    static const luaL_Reg funcs[] = {
+        {"start", l_trace_start},
+        {"stop", l_trace_stop},
+        {"enabled", l_trace_enabled},
+        {"dump", l_trace_dump},
+        {"clear", l_trace_clear},
+        {NULL, NULL}
+    };
+    lua_newtable(L);
+    luaL_setfuncs(L, funcs, 0);
+}
+
+// xshare.options([opts]) -> 当前选项
+// 设置 opts 中给出的进程级选项，返回设置后的全部选项
+static int l_options(lua_State* L) {
+    if (!lua_isnoneornil(L, 1)) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        if (lua_getfield(L, 1, "strip_functions") != LUA_TNIL)
+            stored_set_strip_functions(lua_toboolean(L, -1));
+        lua_pop(L, 1);
+        if (lua_getfield(L, 1, "tx_timeout") != LUA_TNIL)
+            shared_table_set_tx_timeout(luaL_checknumber(L, -1));
+        lua_pop(L, 1);
+    }
+    lua_newtable(L);
+    lua_pushboolean(L, stored_get_strip_functions());
+    lua_setfield(L, -2, "strip_functions");
+    lua_pushnumber(L, shared_table_get_tx_timeout());
+    lua_setfield(L, -2, "tx_timeout");
+    return 1;
+}
+
+// xshare.pack(v) / heap.pack(v) -> 句柄
+// 只序列化一次；句柄存入共享表、缓存、队列时直接引用同一个对象，取出时还原为 v 的副本
+static int l_pack(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    luaL_checkany(L, 1);
+    StoredObject** ud = (StoredObject**)lua_newuserdata(L, sizeof(StoredObject*));
+    *ud = NULL;
+    luaL_setmetatable(L, STORED_PACK_MT);
+    StoredObject* obj = stored_create_ex(L, 1, gc);
+    if (!obj) return luaL_error(L, "cannot pack value of type %s", luaL_typename(L, 1));
+    *ud = obj;   // 创建时持有的引用转交给句柄
+    return 1;
+}
+
+// xshare.unpack(h) -> 打包的值（表和函数每次还原为新的副本）
+static int l_unpack(lua_State* L) {
+    StoredObject** ud = (StoredObject**)luaL_checkudata(L, 1, STORED_PACK_MT);
+    stored_push(L, *ud);
+    return 1;
+}
+
+static int l_pack_gc(lua_State* L) {
+    StoredObject** ud = (StoredObject**)lua_touserdata(L, 1);
+    if (*ud) {
+        gc_release((GCObject*)(*ud));
+        *ud = NULL;
+    }
+    return 0;
+}
+
+static int l_pack_tostring(lua_State* L) {
+    StoredObject** ud = (StoredObject**)luaL_checkudata(L, 1, STORED_PACK_MT);
+    lua_pushfstring(L, "xshare.packed: %p", (void*)*ud);
+    return 1;
+}
+
+static const char* HEAP_MT = "XShare.heap";
+
+// 堆句柄被回收时释放句柄引用（见 gc_heap_release）
+static int l_heap_gc(lua_State* L) {
+    GC** ud = (GC**)lua_touserdata(L, 1);
+    if (*ud) {
+        gc_heap_release(*ud);
+        *ud = NULL;
+    }
+    return 0;
+}
+
+// xshare.heap() -> { table = function, array = function, struct = function, lru = function, pqueue = function, pack = function, gc = {...} }
+// 创建独立的堆：heap.table()/array()/struct()/lru()/pqueue()/pack() 在其中分配对象，heap.gc 控制它的收集。
+// 这些函数共享一个堆句柄作为 upvalue，它们都被回收后释放堆（仍存活的对象保持堆存活）
+static int l_heap_new(lua_State* L) {
+    static const lua_CFunction ctors[] = {
+        l_shared_table_new, l_shared_array_new, l_shared_struct_new,
+        l_shared_lru_new, l_shared_pqueue_new, l_pack
+    };
+    static const char* names[] = { "table", "array", "struct", "lru", "pqueue", "pack" };
+    GC** ud = (GC**)lua_newuserdata(L, sizeof(GC*));
+    *ud = NULL;
+    luaL_setmetatable(L, HEAP_MT);
+    *ud = gc_new();
+    if (!*ud) return luaL_error(L, "cannot create heap");
+    int handle = lua_gettop(L);
+    lua_newtable(L);
+    for (size_t i = 0; i < sizeof(ctors) / sizeof(ctors[0]); i++) {
+        lua_pushvalue(L, handle);
+        lua_pushcclosure(L, ctors[i], 1);
+        lua_setfield(L, -2, names[i]);
+    }
+    lua_pushvalue(L, handle);
+    push_gc_table(L);
+    lua_setfield(L, -2, "gc");
+    return 1;
+}
+
 // 注册模块
 int luaopen_XShare(lua_State* L) {
     // 创建metatable
@@ -60,6 +400,106 @@ int luaopen_XShare(lua_State* L) {
     luaL_setfuncs(L, mt, 0);
     lua_pop(L, 1);
 
+    // 数组的元表同时存放方法（__index 对字符串键查元表）
+    luaL_newmetatable(L, SHARED_ARRAY_MT);
+    static const luaL_Reg array_mt[] = {
+        {"__index", l_shared_array_index},
+        {"__newindex", l_shared_array_newindex},
+        {"__len", l_shared_array_len},
+        {"__gc", l_shared_array_gc},
+        {"__tostring", l_shared_array_tostring},
+        {"kind", l_shared_array_kind},
+        {"sum", l_shared_array_sum},
+        {"min", l_shared_array_min},
+        {"max", l_shared_array_max},
+        {"dot", l_shared_array_dot},
+        {"scale", l_shared_array_scale},
+        {"add", l_shared_array_add},
+        {"fill", l_shared_array_fill},
+        {"copy_from", l_shared_array_copy_from},
+        {"add_at", l_shared_array_add_at},
+        {"totable", l_shared_array_totable},
+        {NULL, NULL}
+    };
+    luaL_setfuncs(L, array_mt, 0);
+    lua_pop(L, 1);
+    stored_register_userdata(SHARED_ARRAY_KIND, SHARED_ARRAY_MT);   // 数组可以存入共享表
+
+    // 结构描述与记录
+    luaL_newmetatable(L, SHARED_SCHEMA_MT);
+    static const luaL_Reg schema_mt[] = {
+        {"__call", l_shared_schema_call},
+        {"__index", l_shared_schema_index},
+        {"__len", l_shared_schema_len},
+        {"__gc", l_shared_schema_gc},
+        {"__tostring", l_shared_schema_tostring},
+        {NULL, NULL}
+    };
+    luaL_setfuncs(L, schema_mt, 0);
+    lua_pop(L, 1);
+    luaL_newmetatable(L, SHARED_RECORD_MT);
+    static const luaL_Reg record_mt[] = {
+        {"__index", l_shared_record_index},
+        {"__newindex", l_shared_record_newindex},
+        {"__pairs", l_shared_record_pairs},
+        {"__gc", l_shared_record_gc},
+        {"__tostring", l_shared_record_tostring},
+        {NULL, NULL}
+    };
+    luaL_setfuncs(L, record_mt, 0);
+    lua_pop(L, 1);
+    stored_register_userdata(SHARED_SCHEMA_KIND, SHARED_SCHEMA_MT);
+    stored_register_userdata(SHARED_RECORD_KIND, SHARED_RECORD_MT);
+
+    // 缓存的元表同时存放方法（键可以是任意值，不提供 c[k] 形式的访问）
+    luaL_newmetatable(L, SHARED_LRU_MT);
+    static const luaL_Reg lru_mt[] = {
+        {"__len", l_shared_lru_len},
+        {"__gc", l_shared_lru_gc},
+        {"__tostring", l_shared_lru_tostring},
+        {"get", l_shared_lru_get},
+        {"put", l_shared_lru_put},
+        {"delete", l_shared_lru_delete},
+        {"clear", l_shared_lru_clear},
+        {"stats", l_shared_lru_stats},
+        {NULL, NULL}
+    };
+    luaL_setfuncs(L, lru_mt, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+    stored_register_userdata(SHARED_LRU_KIND, SHARED_LRU_MT);
+
+    luaL_newmetatable(L, SHARED_PQUEUE_MT);
+    static const luaL_Reg pqueue_mt[] = {
+        {"__len", l_shared_pqueue_len},
+        {"__gc", l_shared_pqueue_gc},
+        {"__tostring", l_shared_pqueue_tostring},
+        {"push", l_shared_pqueue_push},
+        {"pop", l_shared_pqueue_pop},
+        {"pop_n", l_shared_pqueue_pop_n},
+        {"peek", l_shared_pqueue_peek},
+        {"clear", l_shared_pqueue_clear},
+        {NULL, NULL}
+    };
+    luaL_setfuncs(L, pqueue_mt, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+    stored_register_userdata(SHARED_PQUEUE_KIND, SHARED_PQUEUE_MT);
+
+    luaL_newmetatable(L, HEAP_MT);
+    lua_pushcfunction(L, l_heap_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, STORED_PACK_MT);
+    lua_pushcfunction(L, l_pack_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pushcfunction(L, l_pack_tostring);
+    lua_setfield(L, -2, "__tostring");
+    lua_pop(L, 1);
+
     // 创建xshare.table构造函数和其他全局函数
     lua_newtable(L);
     lua_pushcfunction(L, l_shared_table_new);
@@ -80,14 +520,69 @@ int luaopen_XShare(lua_State* L) {
     lua_pushcfunction(L, l_shared_table_size);
     lua_setfield(L, -2, "size");
 
-    lua_newtable(L);  // 压入 gc 表
-    lua_pushcfunction(L, l_gc_collect); lua_setfield(L, -2, "collect");
-    lua_pushcfunction(L, l_gc_count);   lua_setfield(L, -2, "count");
-    lua_pushcfunction(L, l_gc_step);    lua_setfield(L, -2, "step");
-    lua_pushcfunction(L, l_gc_pause);   lua_setfield(L, -2, "pause");
-    lua_pushcfunction(L, l_gc_resume);  lua_setfield(L, -2, "resume");
-    lua_pushcfunction(L, l_gc_enabled); lua_setfield(L, -2, "enabled");
+    lua_pushcfunction(L, l_shared_array_new);
+    lua_setfield(L, -2, "array");
+
+    lua_pushcfunction(L, l_shared_struct_new);
+    lua_setfield(L, -2, "struct");
+
+    lua_pushcfunction(L, l_shared_record_incr);
+    lua_setfield(L, -2, "incr");
+
+    lua_pushcfunction(L, l_shared_lru_new);
+    lua_setfield(L, -2, "lru");
+
+    lua_pushcfunction(L, l_shared_pqueue_new);
+    lua_setfield(L, -2, "pqueue");
+
+    lua_pushcfunction(L, l_shared_table_stats);
+    lua_setfield(L, -2, "stats");
+
+    lua_pushcfunction(L, l_shared_table_transaction);
+    lua_setfield(L, -2, "transaction");
+
+    lua_pushcfunction(L, l_shared_table_changelog);
+    lua_setfield(L, -2, "changelog");
+
+    lua_pushcfunction(L, l_shared_table_changes);
+    lua_setfield(L, -2, "changes");
+
+    lua_pushcfunction(L, l_shared_table_cached);
+    lua_setfield(L, -2, "cached");
+
+    lua_pushcfunction(L, l_shared_table_totable);
+    lua_setfield(L, -2, "totable");
+
+    lua_pushcfunction(L, l_shared_table_foreach);
+    lua_setfield(L, -2, "foreach");
+
+    lua_pushcfunction(L, l_shared_table_setex);
+    lua_setfield(L, -2, "setex");
+
+    lua_pushcfunction(L, l_shared_table_default_ttl);
+    lua_setfield(L, -2, "default_ttl");
+
+    lua_pushcfunction(L, l_shared_table_expire);
+    lua_setfield(L, -2, "expire");
+
+    lua_pushcfunction(L, l_pack);
+    lua_setfield(L, -2, "pack");
+
+    lua_pushcfunction(L, l_unpack);
+    lua_setfield(L, -2, "unpack");
+
+    lua_pushcfunction(L, l_heap_new);
+    lua_setfield(L, -2, "heap");
+
+    lua_pushcfunction(L, l_options);
+    lua_setfield(L, -2, "options");
+
+    lua_pushlightuserdata(L, gc_instance());
+    push_gc_table(L);  // 压入默认堆的 gc 表
     lua_setfield(L, -2, "gc");  // 将 gc 表设置到主表中
 
+    push_trace_table(L);
+    lua_setfield(L, -2, "trace");
+
     return 1;
 }
\ No newline at end of file
@@ -4,6 +4,10 @@
 #include "lua.h"
 #include "GC.h"
 #include "shared_table.h"
+#include "shared_array.h"
+#include "shared_struct.h"
+#include "shared_lru.h"
+#include "shared_pqueue.h"
 #include "stored_object.h"
 
 #ifdef __cplusplus
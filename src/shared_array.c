@@ -0,0 +1,719 @@
+#include "shared_array.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "lauxlib.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ARRAY_X86 1
+#include <immintrin.h>
+#define AVX_FN __attribute__((target("avx")))
+#endif
+
+static const char* const kind_names[ARRAY_KIND_COUNT] = {
+    [ARRAY_F64] = "f64",
+    [ARRAY_F32] = "f32",
+    [ARRAY_I64] = "i64",
+    [ARRAY_I32] = "i32",
+    [ARRAY_U8] = "u8",
+};
+
+static const size_t kind_sizes[ARRAY_KIND_COUNT] = {
+    [ARRAY_F64] = sizeof(double),
+    [ARRAY_F32] = sizeof(float),
+    [ARRAY_I64] = sizeof(int64_t),
+    [ARRAY_I32] = sizeof(int32_t),
+    [ARRAY_U8] = sizeof(uint8_t),
+};
+
+int shared_array_kind_from_name(const char* name) {
+    for (int k = 0; k < ARRAY_KIND_COUNT; k++) {
+        if (strcmp(name, kind_names[k]) == 0) return k;
+    }
+    return -1;
+}
+
+const char* shared_array_kind_name(ArrayKind kind) {
+    return kind_names[kind];
+}
+
+static void shared_array_dtor(GCObject* obj) {
+    SharedArray* a = (SharedArray*)obj;
+    if (a->data) {
+        gc_account(obj, GC_MEM_ARRAY, -(ptrdiff_t)(a->length * a->elemSize));
+        free(a->data);
+    }
+}
+
+SharedArray* shared_array_create(GC* gc, ArrayKind kind, size_t n) {
+    size_t elemSize = kind_sizes[kind];
+    if (n > SIZE_MAX / elemSize) return NULL;
+    void* data = NULL;
+    if (n > 0) {
+        if (posix_memalign(&data, SHARED_ARRAY_ALIGN, n * elemSize) != 0) return NULL;
+        memset(data, 0, n * elemSize);
+    }
+    SharedArray* a = (SharedArray*)gc_create(gc, sizeof(SharedArray) - sizeof(GCObject));
+    if (!a) {
+        free(data);
+        return NULL;
+    }
+    a->header.dtor = shared_array_dtor;
+    a->header.flags |= GC_FLAG_LEAF;   // 没有出边
+    gc_set_kind(&a->header, SHARED_ARRAY_KIND);
+    a->kind = kind;
+    a->length = n;
+    a->elemSize = elemSize;
+    a->data = data;
+    if (data)
+        gc_account(&a->header, GC_MEM_ARRAY, (ptrdiff_t)(n * elemSize));
+    return a;
+}
+
+// ---------- 元素访问 ----------
+
+#define ELEMS(a, T) ((T*)(a)->data)
+
+// 浮点转整数：NaN 为0，超出范围时取边界值
+static int64_t to_int(double v) {
+    if (v != v) return 0;
+    if (v >= 9223372036854775807.0) return INT64_MAX;
+    if (v <= -9223372036854775808.0) return INT64_MIN;
+    return (int64_t)v;
+}
+
+double shared_array_get(const SharedArray* a, size_t i) {
+    switch (a->kind) {
+        case ARRAY_F64: return ELEMS(a, double)[i];
+        case ARRAY_F32: return ELEMS(a, float)[i];
+        case ARRAY_I64: return (double)ELEMS(a, int64_t)[i];
+        case ARRAY_I32: return ELEMS(a, int32_t)[i];
+        case ARRAY_U8:  return ELEMS(a, uint8_t)[i];
+        default: return 0;
+    }
+}
+
+void shared_array_set(SharedArray* a, size_t i, double v) {
+    switch (a->kind) {
+        case ARRAY_F64: ELEMS(a, double)[i] = v; break;
+        case ARRAY_F32: ELEMS(a, float)[i] = (float)v; break;
+        default: shared_array_set_int(a, i, to_int(v)); break;
+    }
+}
+
+int64_t shared_array_get_int(const SharedArray* a, size_t i) {
+    switch (a->kind) {
+        case ARRAY_I64: return ELEMS(a, int64_t)[i];
+        case ARRAY_I32: return ELEMS(a, int32_t)[i];
+        case ARRAY_U8:  return ELEMS(a, uint8_t)[i];
+        default: return to_int(shared_array_get(a, i));
+    }
+}
+
+void shared_array_set_int(SharedArray* a, size_t i, int64_t v) {
+    switch (a->kind) {
+        case ARRAY_F64: ELEMS(a, double)[i] = (double)v; break;
+        case ARRAY_F32: ELEMS(a, float)[i] = (float)v; break;
+        case ARRAY_I64: ELEMS(a, int64_t)[i] = v; break;
+        case ARRAY_I32: ELEMS(a, int32_t)[i] = (int32_t)v; break;
+        case ARRAY_U8:  ELEMS(a, uint8_t)[i] = (uint8_t)v; break;
+        default: break;
+    }
+}
+
+void shared_array_add_at(SharedArray* a, size_t i, double v) {
+    switch (a->kind) {
+        case ARRAY_F64: {
+            // 浮点没有原子加法，按位模式做CAS
+            uint64_t* p = (uint64_t*)a->data + i;
+            uint64_t old = __atomic_load_n(p, __ATOMIC_RELAXED), upd;
+            do {
+                double d;
+                memcpy(&d, &old, sizeof(d));
+                d += v;
+                memcpy(&upd, &d, sizeof(d));
+            } while (!__atomic_compare_exchange_n(p, &old, upd, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+            break;
+        }
+        case ARRAY_F32: {
+            uint32_t* p = (uint32_t*)a->data + i;
+            uint32_t old = __atomic_load_n(p, __ATOMIC_RELAXED), upd;
+            do {
+                float f;
+                memcpy(&f, &old, sizeof(f));
+                f += (float)v;
+                memcpy(&upd, &f, sizeof(f));
+            } while (!__atomic_compare_exchange_n(p, &old, upd, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+            break;
+        }
+        default:
+            shared_array_add_at_int(a, i, to_int(v));
+            break;
+    }
+}
+
+void shared_array_add_at_int(SharedArray* a, size_t i, int64_t v) {
+    switch (a->kind) {
+        case ARRAY_I64: __atomic_fetch_add(ELEMS(a, int64_t) + i, v, __ATOMIC_RELAXED); break;
+        case ARRAY_I32: __atomic_fetch_add(ELEMS(a, int32_t) + i, (int32_t)v, __ATOMIC_RELAXED); break;
+        case ARRAY_U8:  __atomic_fetch_add(ELEMS(a, uint8_t) + i, (uint8_t)v, __ATOMIC_RELAXED); break;
+        default: shared_array_add_at(a, i, (double)v); break;
+    }
+}
+
+// ---------- 向量内核 ----------
+
+#ifdef ARRAY_X86
+static atomic_int avx_state = -1;
+
+// 运行时检测 CPU（及操作系统）是否支持 AVX
+static int use_avx(void) {
+    int v = atomic_load_explicit(&avx_state, memory_order_relaxed);
+    if (v < 0) {
+        __builtin_cpu_init();
+        v = __builtin_cpu_supports("avx") ? 1 : 0;
+        atomic_store_explicit(&avx_state, v, memory_order_relaxed);
+    }
+    return v;
+}
+
+AVX_FN static double sum_f64_avx(const double* p, size_t n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(p + i));
+        s1 = _mm256_add_pd(s1, _mm256_loadu_pd(p + i + 4));
+    }
+    double t[4];
+    _mm256_storeu_pd(t, _mm256_add_pd(s0, s1));
+    double s = (t[0] + t[1]) + (t[2] + t[3]);
+    for (; i < n; i++) s += p[i];
+    return s;
+}
+
+// 单精度按双精度累加，避免长数组的精度损失
+AVX_FN static double sum_f32_avx(const float* p, size_t n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm_loadu_ps(p + i)));
+        s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm_loadu_ps(p + i + 4)));
+    }
+    double t[4];
+    _mm256_storeu_pd(t, _mm256_add_pd(s0, s1));
+    double s = (t[0] + t[1]) + (t[2] + t[3]);
+    for (; i < n; i++) s += p[i];
+    return s;
+}
+
+AVX_FN static double dot_f64_avx(const double* a, const double* b, size_t n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double t[4];
+    _mm256_storeu_pd(t, _mm256_add_pd(s0, s1));
+    double s = (t[0] + t[1]) + (t[2] + t[3]);
+    for (; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+AVX_FN static double dot_f32_avx(const float* a, const float* b, size_t n) {
+    __m256d s = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(a + i));
+        __m256d y = _mm256_cvtps_pd(_mm_loadu_ps(b + i));
+        s = _mm256_add_pd(s, _mm256_mul_pd(x, y));
+    }
+    double t[4];
+    _mm256_storeu_pd(t, s);
+    double r = (t[0] + t[1]) + (t[2] + t[3]);
+    for (; i < n; i++) r += (double)a[i] * b[i];
+    return r;
+}
+
+/* n >= 1。含 NaN 时最小值和最大值都为 NaN（与标量实现相同）；
+ * min/max 指令遇到 NaN 的结果取决于操作数顺序，所以另用比较掩码记录是否出现过 NaN */
+AVX_FN static void minmax_f64_avx(const double* p, size_t n, double* mn, double* mx) {
+    __m256d lo = _mm256_set1_pd(p[0]), hi = lo, nan = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(p + i);
+        lo = _mm256_min_pd(lo, v);
+        hi = _mm256_max_pd(hi, v);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+    }
+    int anyNan = _mm256_movemask_pd(nan) != 0;
+    double l[4], h[4];
+    _mm256_storeu_pd(l, lo);
+    _mm256_storeu_pd(h, hi);
+    double a = l[0], b = h[0];
+    for (int k = 1; k < 4; k++) {
+        if (l[k] < a) a = l[k];
+        if (h[k] > b) b = h[k];
+    }
+    for (; i < n; i++) {
+        if (isnan(p[i])) anyNan = 1;
+        if (p[i] < a) a = p[i];
+        if (p[i] > b) b = p[i];
+    }
+    *mn = anyNan ? NAN : a;
+    *mx = anyNan ? NAN : b;
+}
+
+AVX_FN static void minmax_f32_avx(const float* p, size_t n, double* mn, double* mx) {
+    __m256 lo = _mm256_set1_ps(p[0]), hi = lo, nan = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(p + i);
+        lo = _mm256_min_ps(lo, v);
+        hi = _mm256_max_ps(hi, v);
+        nan = _mm256_or_ps(nan, _mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+    }
+    int anyNan = _mm256_movemask_ps(nan) != 0;
+    float l[8], h[8];
+    _mm256_storeu_ps(l, lo);
+    _mm256_storeu_ps(h, hi);
+    float a = l[0], b = h[0];
+    for (int k = 1; k < 8; k++) {
+        if (l[k] < a) a = l[k];
+        if (h[k] > b) b = h[k];
+    }
+    for (; i < n; i++) {
+        if (isnan(p[i])) anyNan = 1;
+        if (p[i] < a) a = p[i];
+        if (p[i] > b) b = p[i];
+    }
+    *mn = anyNan ? NAN : a;
+    *mx = anyNan ? NAN : b;
+}
+
+AVX_FN static void scale_f64_avx(double* p, size_t n, double k) {
+    __m256d f = _mm256_set1_pd(k);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(p + i, _mm256_mul_pd(_mm256_loadu_pd(p + i), f));
+    for (; i < n; i++) p[i] *= k;
+}
+
+AVX_FN static void scale_f32_avx(float* p, size_t n, float k) {
+    __m256 f = _mm256_set1_ps(k);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(p + i, _mm256_mul_ps(_mm256_loadu_ps(p + i), f));
+    for (; i < n; i++) p[i] *= k;
+}
+
+AVX_FN static void add_f64_avx(double* a, const double* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(a + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    for (; i < n; i++) a[i] += b[i];
+}
+
+AVX_FN static void add_f32_avx(float* a, const float* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(a + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    for (; i < n; i++) a[i] += b[i];
+}
+#else
+static int use_avx(void) { return 0; }
+#endif
+
+// ---------- 批量运算 ----------
+
+double shared_array_sum(const SharedArray* a) {
+    size_t n = a->length;
+    double s = 0;
+    switch (a->kind) {
+        case ARRAY_F64:
+#ifdef ARRAY_X86
+            if (use_avx()) return sum_f64_avx(ELEMS(a, double), n);
+#endif
+            for (size_t i = 0; i < n; i++) s += ELEMS(a, double)[i];
+            return s;
+        case ARRAY_F32:
+#ifdef ARRAY_X86
+            if (use_avx()) return sum_f32_avx(ELEMS(a, float), n);
+#endif
+            for (size_t i = 0; i < n; i++) s += ELEMS(a, float)[i];
+            return s;
+        default:
+            return (double)shared_array_sum_int(a);
+    }
+}
+
+int64_t shared_array_sum_int(const SharedArray* a) {
+    size_t n = a->length;
+    uint64_t s = 0;   // 无符号累加，溢出时回绕而不是未定义行为
+    switch (a->kind) {
+        case ARRAY_I64:
+            for (size_t i = 0; i < n; i++) s += (uint64_t)ELEMS(a, int64_t)[i];
+            return (int64_t)s;
+        case ARRAY_I32:
+            for (size_t i = 0; i < n; i++) s += (uint64_t)(int64_t)ELEMS(a, int32_t)[i];
+            return (int64_t)s;
+        case ARRAY_U8:
+            for (size_t i = 0; i < n; i++) s += ELEMS(a, uint8_t)[i];
+            return (int64_t)s;
+        default:
+            return to_int(shared_array_sum(a));
+    }
+}
+
+static int minmax(const SharedArray* a, double* mn, double* mx) {
+    size_t n = a->length;
+    if (n == 0) return 0;
+#ifdef ARRAY_X86
+    if (a->kind == ARRAY_F64 && use_avx()) {
+        minmax_f64_avx(ELEMS(a, double), n, mn, mx);
+        return 1;
+    }
+    if (a->kind == ARRAY_F32 && use_avx()) {
+        minmax_f32_avx(ELEMS(a, float), n, mn, mx);
+        return 1;
+    }
+#endif
+    double lo = shared_array_get(a, 0), hi = lo;
+    for (size_t i = 0; i < n; i++) {
+        double v = shared_array_get(a, i);
+        if (isnan(v)) {
+            lo = hi = NAN;   // NaN 传播：含 NaN 时最值都为 NaN
+            break;
+        }
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    *mn = lo;
+    *mx = hi;
+    return 1;
+}
+
+int shared_array_min(const SharedArray* a, double* out) {
+    double mx;
+    return minmax(a, out, &mx);
+}
+
+int shared_array_max(const SharedArray* a, double* out) {
+    double mn;
+    return minmax(a, &mn, out);
+}
+
+static int same_shape(const SharedArray* a, const SharedArray* b) {
+    return a->kind == b->kind && a->length == b->length;
+}
+
+int shared_array_dot(const SharedArray* a, const SharedArray* b, double* out) {
+    if (!same_shape(a, b)) return 0;
+    size_t n = a->length;
+    double s = 0;
+    switch (a->kind) {
+        case ARRAY_F64:
+#ifdef ARRAY_X86
+            if (use_avx()) { *out = dot_f64_avx(ELEMS(a, double), ELEMS(b, double), n); return 1; }
+#endif
+            for (size_t i = 0; i < n; i++) s += ELEMS(a, double)[i] * ELEMS(b, double)[i];
+            break;
+        case ARRAY_F32:
+#ifdef ARRAY_X86
+            if (use_avx()) { *out = dot_f32_avx(ELEMS(a, float), ELEMS(b, float), n); return 1; }
+#endif
+            for (size_t i = 0; i < n; i++) s += (double)ELEMS(a, float)[i] * ELEMS(b, float)[i];
+            break;
+        default:
+            for (size_t i = 0; i < n; i++) s += shared_array_get(a, i) * shared_array_get(b, i);
+            break;
+    }
+    *out = s;
+    return 1;
+}
+
+void shared_array_scale(SharedArray* a, double k) {
+    size_t n = a->length;
+    switch (a->kind) {
+        case ARRAY_F64:
+#ifdef ARRAY_X86
+            if (use_avx()) { scale_f64_avx(ELEMS(a, double), n, k); return; }
+#endif
+            for (size_t i = 0; i < n; i++) ELEMS(a, double)[i] *= k;
+            break;
+        case ARRAY_F32:
+#ifdef ARRAY_X86
+            if (use_avx()) { scale_f32_avx(ELEMS(a, float), n, (float)k); return; }
+#endif
+            for (size_t i = 0; i < n; i++) ELEMS(a, float)[i] *= (float)k;
+            break;
+        default:
+            for (size_t i = 0; i < n; i++) shared_array_set(a, i, shared_array_get(a, i) * k);
+            break;
+    }
+}
+
+int shared_array_add(SharedArray* a, const SharedArray* b) {
+    if (!same_shape(a, b)) return 0;
+    size_t n = a->length;
+    switch (a->kind) {
+        case ARRAY_F64:
+#ifdef ARRAY_X86
+            if (use_avx()) { add_f64_avx(ELEMS(a, double), ELEMS(b, double), n); return 1; }
+#endif
+            for (size_t i = 0; i < n; i++) ELEMS(a, double)[i] += ELEMS(b, double)[i];
+            break;
+        case ARRAY_F32:
+#ifdef ARRAY_X86
+            if (use_avx()) { add_f32_avx(ELEMS(a, float), ELEMS(b, float), n); return 1; }
+#endif
+            for (size_t i = 0; i < n; i++) ELEMS(a, float)[i] += ELEMS(b, float)[i];
+            break;
+        case ARRAY_I64:   // 整数按回绕相加
+            for (size_t i = 0; i < n; i++)
+                ELEMS(a, int64_t)[i] = (int64_t)((uint64_t)ELEMS(a, int64_t)[i] + (uint64_t)ELEMS(b, int64_t)[i]);
+            break;
+        case ARRAY_I32:
+            for (size_t i = 0; i < n; i++)
+                ELEMS(a, int32_t)[i] = (int32_t)((uint32_t)ELEMS(a, int32_t)[i] + (uint32_t)ELEMS(b, int32_t)[i]);
+            break;
+        case ARRAY_U8:
+            for (size_t i = 0; i < n; i++) ELEMS(a, uint8_t)[i] += ELEMS(b, uint8_t)[i];
+            break;
+        default:
+            break;
+    }
+    return 1;
+}
+
+void shared_array_fill(SharedArray* a, double v) {
+    size_t n = a->length;
+    if (n == 0) return;
+    if (a->kind == ARRAY_U8) {
+        memset(a->data, (uint8_t)to_int(v), n);
+        return;
+    }
+    shared_array_set(a, 0, v);   // 先转换一次，再按字节模式复制
+    for (size_t i = 1; i < n; i++)
+        memcpy((char*)a->data + i * a->elemSize, a->data, a->elemSize);
+}
+
+void shared_array_copy_from(SharedArray* a, const SharedArray* src) {
+    size_t n = a->length < src->length ? a->length : src->length;
+    if (a == src || n == 0) return;
+    if (a->kind == src->kind) {
+        memmove(a->data, src->data, n * a->elemSize);
+        return;
+    }
+    if (shared_array_is_int(a) && shared_array_is_int(src)) {
+        for (size_t i = 0; i < n; i++) shared_array_set_int(a, i, shared_array_get_int(src, i));
+    } else {
+        for (size_t i = 0; i < n; i++) shared_array_set(a, i, shared_array_get(src, i));
+    }
+}
+
+// ---------- Lua 绑定 ----------
+
+const char* SHARED_ARRAY_MT = "XShare.array";
+
+SharedArray* check_shared_array(lua_State* L, int idx) {
+    void* ud = luaL_checkudata(L, idx, SHARED_ARRAY_MT);
+    return *(SharedArray**)ud;
+}
+
+// 下标从1开始
+static size_t check_index(lua_State* L, SharedArray* a, int arg) {
+    lua_Integer i = luaL_checkinteger(L, arg);
+    luaL_argcheck(L, i >= 1 && (lua_Unsigned)i <= a->length, arg, "index out of range");
+    return (size_t)(i - 1);
+}
+
+static void push_elem(lua_State* L, SharedArray* a, size_t i) {
+    if (shared_array_is_int(a))
+        lua_pushinteger(L, (lua_Integer)shared_array_get_int(a, i));
+    else
+        lua_pushnumber(L, shared_array_get(a, i));
+}
+
+static void set_elem(lua_State* L, SharedArray* a, size_t i, int idx) {
+    if (shared_array_is_int(a) && lua_isinteger(L, idx))
+        shared_array_set_int(a, i, (int64_t)lua_tointeger(L, idx));
+    else
+        shared_array_set(a, i, luaL_checknumber(L, idx));
+}
+
+// 从 Lua 表复制前 n 个元素
+static void copy_from_table(lua_State* L, SharedArray* a, int idx) {
+    size_t n = (size_t)lua_rawlen(L, idx);
+    if (n > a->length) n = a->length;
+    for (size_t i = 0; i < n; i++) {
+        lua_rawgeti(L, idx, (lua_Integer)i + 1);
+        set_elem(L, a, i, -1);
+        lua_pop(L, 1);
+    }
+}
+
+// xshare.array(kind, n | tbl) / heap.array(kind, n | tbl)
+int l_shared_array_new(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    int kind = shared_array_kind_from_name(luaL_checkstring(L, 1));
+    if (kind < 0) return luaL_argerror(L, 1, "expected 'f64', 'f32', 'i64', 'i32' or 'u8'");
+    int fromTable = lua_istable(L, 2);
+    lua_Integer n = fromTable ? (lua_Integer)lua_rawlen(L, 2) : luaL_checkinteger(L, 2);
+    luaL_argcheck(L, n >= 0, 2, "size must be non-negative");
+
+    SharedArray* a = shared_array_create(gc, (ArrayKind)kind, (size_t)n);
+    if (!a) return luaL_error(L, "cannot create shared array");
+    SharedArray** ud = (SharedArray**)lua_newuserdata(L, sizeof(SharedArray*));
+    *ud = a;
+    luaL_setmetatable(L, SHARED_ARRAY_MT);   // 创建时持有的引用转交给userdata
+    stored_remember_object(L, -1);
+    if (fromTable)
+        copy_from_table(L, a, 2);
+    return 1;
+}
+
+// a[i] 读取元素（越界为nil），a.name 查找方法
+int l_shared_array_index(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        lua_Integer i = lua_tointeger(L, 2);
+        if (i >= 1 && (lua_Unsigned)i <= a->length)
+            push_elem(L, a, (size_t)(i - 1));
+        else
+            lua_pushnil(L);
+        return 1;
+    }
+    lua_getmetatable(L, 1);
+    lua_pushvalue(L, 2);
+    lua_rawget(L, -2);
+    return 1;
+}
+
+int l_shared_array_newindex(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    set_elem(L, a, check_index(L, a, 2), 3);
+    return 0;
+}
+
+int l_shared_array_len(lua_State* L) {
+    lua_pushinteger(L, (lua_Integer)check_shared_array(L, 1)->length);
+    return 1;
+}
+
+int l_shared_array_tostring(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    lua_pushfstring(L, "xshare.array(%s, %I): %p", kind_names[a->kind], (lua_Integer)a->length, a);
+    return 1;
+}
+
+int l_shared_array_gc(lua_State* L) {
+    SharedArray** ud = (SharedArray**)lua_touserdata(L, 1);
+    if (*ud) {
+        gc_release((GCObject*)(*ud));
+        *ud = NULL;
+    }
+    return 0;
+}
+
+int l_shared_array_kind(lua_State* L) {
+    lua_pushstring(L, kind_names[check_shared_array(L, 1)->kind]);
+    return 1;
+}
+
+int l_shared_array_sum(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    if (shared_array_is_int(a))
+        lua_pushinteger(L, (lua_Integer)shared_array_sum_int(a));
+    else
+        lua_pushnumber(L, shared_array_sum(a));
+    return 1;
+}
+
+static int push_extreme(lua_State* L, SharedArray* a, int ok, double v) {
+    if (!ok)
+        lua_pushnil(L);
+    else if (shared_array_is_int(a))
+        lua_pushinteger(L, (lua_Integer)to_int(v));
+    else
+        lua_pushnumber(L, v);
+    return 1;
+}
+
+int l_shared_array_min(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    double v = 0;
+    int ok = shared_array_min(a, &v);
+    return push_extreme(L, a, ok, v);
+}
+
+int l_shared_array_max(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    double v = 0;
+    int ok = shared_array_max(a, &v);
+    return push_extreme(L, a, ok, v);
+}
+
+int l_shared_array_dot(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    SharedArray* b = check_shared_array(L, 2);
+    double v;
+    if (!shared_array_dot(a, b, &v))
+        return luaL_argerror(L, 2, "arrays must have the same kind and length");
+    lua_pushnumber(L, v);
+    return 1;
+}
+
+int l_shared_array_scale(lua_State* L) {
+    shared_array_scale(check_shared_array(L, 1), luaL_checknumber(L, 2));
+    return 0;
+}
+
+int l_shared_array_add(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    if (!shared_array_add(a, check_shared_array(L, 2)))
+        return luaL_argerror(L, 2, "arrays must have the same kind and length");
+    return 0;
+}
+
+int l_shared_array_fill(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    if (shared_array_is_int(a) && lua_isinteger(L, 2)) {
+        int64_t v = (int64_t)lua_tointeger(L, 2);
+        for (size_t i = 0; i < a->length; i++) shared_array_set_int(a, i, v);
+    } else {
+        shared_array_fill(a, luaL_checknumber(L, 2));
+    }
+    return 0;
+}
+
+// a:copy_from(src)，src 为数组或 Lua 表
+int l_shared_array_copy_from(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    if (lua_istable(L, 2))
+        copy_from_table(L, a, 2);
+    else
+        shared_array_copy_from(a, check_shared_array(L, 2));
+    return 0;
+}
+
+int l_shared_array_add_at(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    size_t i = check_index(L, a, 2);
+    if (shared_array_is_int(a) && lua_isinteger(L, 3))
+        shared_array_add_at_int(a, i, (int64_t)lua_tointeger(L, 3));
+    else
+        shared_array_add_at(a, i, luaL_checknumber(L, 3));
+    return 0;
+}
+
+int l_shared_array_totable(lua_State* L) {
+    SharedArray* a = check_shared_array(L, 1);
+    lua_createtable(L, (int)a->length, 0);
+    for (size_t i = 0; i < a->length; i++) {
+        push_elem(L, a, i);
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+    return 1;
+}
@@ -0,0 +1,93 @@
+#ifndef SHARED_ARRAY_H
+#define SHARED_ARRAY_H
+
+#include <lua.h>
+#include <stdint.h>
+#include "GC.h"
+#include "shared_table.h"
+
+// SharedArray 的GC对象种类
+#define SHARED_ARRAY_KIND (SHARED_TABLE_KIND + 1)
+
+// 元素数组的对齐（缓存行）
+#define SHARED_ARRAY_ALIGN 64
+
+extern const char* SHARED_ARRAY_MT;
+
+typedef enum ArrayKind {
+    ARRAY_F64,
+    ARRAY_F32,
+    ARRAY_I64,
+    ARRAY_I32,
+    ARRAY_U8,
+    ARRAY_KIND_COUNT
+} ArrayKind;
+
+/* 定长数值数组：元素存放在一块连续、按缓存行对齐的内存中，整个数组只有一个GC对象。
+ * 元素读写不加锁（与普通内存相同），并发累加同一元素用 shared_array_add_at。
+ * 写入整数类型时按C的转换规则截断（u8 回绕） */
+typedef struct SharedArray {
+    GCObject header;
+    ArrayKind kind;
+    size_t length;
+    size_t elemSize;
+    void* data;
+} SharedArray;
+
+// 创建 n 个元素、全部为0的数组
+SharedArray* shared_array_create(GC* gc, ArrayKind kind, size_t n);
+
+// 类型名（"f64"、"f32"、"i64"、"i32"、"u8"）与 ArrayKind 互转，未知名称返回-1
+int shared_array_kind_from_name(const char* name);
+const char* shared_array_kind_name(ArrayKind kind);
+
+// 是否为整数类型
+static inline int shared_array_is_int(const SharedArray* a) {
+    return a->kind != ARRAY_F64 && a->kind != ARRAY_F32;
+}
+
+// 元素读写（下标从0开始，调用者保证不越界）。_int 版本对 i64 不损失精度
+double shared_array_get(const SharedArray* a, size_t i);
+void shared_array_set(SharedArray* a, size_t i, double v);
+int64_t shared_array_get_int(const SharedArray* a, size_t i);
+void shared_array_set_int(SharedArray* a, size_t i, int64_t v);
+
+// 原子地把 v 加到第 i 个元素上
+void shared_array_add_at(SharedArray* a, size_t i, double v);
+void shared_array_add_at_int(SharedArray* a, size_t i, int64_t v);
+
+/* 批量运算。浮点类型在支持 AVX 的 x86 CPU 上使用向量指令（运行时检测），否则为标量实现。
+ * 二元运算要求两个数组类型与长度都相同，否则返回0 */
+double shared_array_sum(const SharedArray* a);
+int64_t shared_array_sum_int(const SharedArray* a);   // 整数类型
+int shared_array_min(const SharedArray* a, double* out);   // 空数组返回0
+int shared_array_max(const SharedArray* a, double* out);
+int shared_array_dot(const SharedArray* a, const SharedArray* b, double* out);
+void shared_array_scale(SharedArray* a, double k);
+int shared_array_add(SharedArray* a, const SharedArray* b);   // a += b
+void shared_array_fill(SharedArray* a, double v);
+
+// 从 src 复制前 min(a->length, src->length) 个元素，类型不同时逐个转换
+void shared_array_copy_from(SharedArray* a, const SharedArray* src);
+
+// 以下为Lua绑定函数
+SharedArray* check_shared_array(lua_State* L, int idx);
+int l_shared_array_new(lua_State* L);
+int l_shared_array_index(lua_State* L);
+int l_shared_array_newindex(lua_State* L);
+int l_shared_array_len(lua_State* L);
+int l_shared_array_tostring(lua_State* L);
+int l_shared_array_gc(lua_State* L);
+int l_shared_array_kind(lua_State* L);
+int l_shared_array_sum(lua_State* L);
+int l_shared_array_min(lua_State* L);
+int l_shared_array_max(lua_State* L);
+int l_shared_array_dot(lua_State* L);
+int l_shared_array_scale(lua_State* L);
+int l_shared_array_add(lua_State* L);
+int l_shared_array_fill(lua_State* L);
+int l_shared_array_copy_from(lua_State* L);
+int l_shared_array_add_at(lua_State* L);
+int l_shared_array_totable(lua_State* L);
+
+#endif
@@ -0,0 +1,423 @@
+#include "shared_lru.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "lauxlib.h"
+
+const char* SHARED_LRU_MT = "XShare.lru";
+
+#define LRU_MIN_BUCKETS 16
+#define LRU_SHARD_MIN 8
+
+static inline void lru_count(atomic_size_t* counter) {
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+// 分片取乘法散列的最高几位，与哈希桶用的低位无关（size_t 为32位时同样适用）
+static inline size_t lru_shard_index(SharedLru* lru, size_t hash) {
+    return (size_t)(((uint64_t)hash * 0x9E3779B97F4A7C15ull) >> 60) & lru->shardMask;
+}
+
+static inline LruShard* lru_shard(SharedLru* lru, size_t hash) {
+    return &lru->shards[lru_shard_index(lru, hash)];
+}
+
+static inline size_t lru_bucket(const LruShard* s, size_t hash) {
+    return (hash >> 4) & (s->nbuckets - 1);
+}
+
+// ---------- 链表与哈希表（持有分片锁） ----------
+
+static void list_unlink(LruEntry* e) {
+    e->prev->next = e->next;
+    e->next->prev = e->prev;
+}
+
+static void list_push_front(LruShard* s, LruEntry* e) {
+    e->prev = &s->list;
+    e->next = s->list.next;
+    s->list.next->prev = e;
+    s->list.next = e;
+}
+
+static LruEntry* shard_find(LruShard* s, const StoredObject* key, size_t hash) {
+    if (!s->nbuckets) return NULL;
+    for (LruEntry* e = s->buckets[lru_bucket(s, hash)]; e; e = e->hnext) {
+        if (e->hash == hash && stored_compare(e->key, key) == 0) return e;
+    }
+    return NULL;
+}
+
+// 从哈希链中摘除（调用者在 gc_mutate_begin 内）
+static void shard_unhash(LruShard* s, LruEntry* e) {
+    LruEntry** p = &s->buckets[lru_bucket(s, e->hash)];
+    while (*p != e)
+        p = &(*p)->hnext;
+    *p = e->hnext;
+}
+
+// 条目数超过桶数时加倍（调用者在 gc_mutate_begin 内）
+static int shard_grow(SharedLru* lru, LruShard* s) {
+    if (s->count < s->nbuckets) return 1;
+    size_t n = s->nbuckets ? s->nbuckets * 2 : LRU_MIN_BUCKETS;
+    LruEntry** buckets = (LruEntry**)calloc(n, sizeof(LruEntry*));
+    if (!buckets) return s->nbuckets != 0;   // 已有桶时只是链变长
+    size_t old = s->nbuckets;
+    LruEntry** oldBuckets = s->buckets;
+    s->buckets = buckets;
+    s->nbuckets = n;
+    for (size_t i = 0; i < old; i++) {
+        LruEntry* e = oldBuckets[i];
+        while (e) {
+            LruEntry* next = e->hnext;
+            size_t b = lru_bucket(s, e->hash);
+            e->hnext = buckets[b];
+            buckets[b] = e;
+            e = next;
+        }
+    }
+    free(oldBuckets);
+    gc_account(&lru->header, GC_MEM_TABLE, (ptrdiff_t)((n - old) * sizeof(LruEntry*)));
+    return 1;
+}
+
+// 调整分片和整个缓存的条目数、字节数（持有分片锁；负数按无符号回绕相加）
+static void lru_adjust(SharedLru* lru, LruShard* s, size_t entries, size_t bytes) {
+    s->count += entries;
+    s->bytes += bytes;
+    atomic_fetch_add_explicit(&lru->count, entries, memory_order_relaxed);
+    atomic_fetch_add_explicit(&lru->bytes, bytes, memory_order_relaxed);
+}
+
+// 移除条目并交还键值（调用者在 gc_mutate_begin 内）
+static void shard_remove(SharedLru* lru, LruShard* s, LruEntry* e) {
+    shard_unhash(s, e);
+    list_unlink(e);
+    lru_adjust(lru, s, (size_t)-1, (size_t)0 - e->bytes);
+    gc_release((GCObject*)e->key);
+    gc_release((GCObject*)e->val);
+    free(e);
+    gc_account(&lru->header, GC_MEM_TABLE, -(ptrdiff_t)sizeof(LruEntry));
+}
+
+static int lru_over(SharedLru* lru) {
+    return (lru->maxEntries && atomic_load_explicit(&lru->count, memory_order_relaxed) > lru->maxEntries) ||
+           (lru->maxBytes && atomic_load_explicit(&lru->bytes, memory_order_relaxed) > lru->maxBytes);
+}
+
+// ---------- GC ----------
+
+// 遍历所有键值。只走哈希链：get 只调整最近使用链表，不在 gc_mutate_begin 内
+static void shared_lru_trace(GCObject* obj, GCVisitor visit, void* ud) {
+    SharedLru* lru = (SharedLru*)obj;
+    for (int i = 0; i < LRU_SHARDS; i++) {
+        LruShard* s = &lru->shards[i];
+        for (size_t b = 0; b < s->nbuckets; b++) {
+            for (LruEntry* e = s->buckets[b]; e; e = e->hnext) {
+                visit((GCObject*)e->key, ud);
+                visit((GCObject*)e->val, ud);
+            }
+        }
+    }
+}
+
+static void shard_free_all(SharedLru* lru, LruShard* s) {
+    for (LruEntry* e = s->list.next; e != &s->list;) {
+        LruEntry* next = e->next;
+        gc_release((GCObject*)e->key);
+        gc_release((GCObject*)e->val);
+        free(e);
+        e = next;
+    }
+    gc_account(&lru->header, GC_MEM_TABLE, -(ptrdiff_t)(s->count * sizeof(LruEntry)));
+    s->list.next = s->list.prev = &s->list;
+    lru_adjust(lru, s, (size_t)0 - s->count, (size_t)0 - s->bytes);
+}
+
+static void shared_lru_dtor(GCObject* obj) {
+    SharedLru* lru = (SharedLru*)obj;
+    for (int i = 0; i < LRU_SHARDS; i++) {
+        LruShard* s = &lru->shards[i];
+        shard_free_all(lru, s);
+        free(s->buckets);
+        gc_account(obj, GC_MEM_TABLE, -(ptrdiff_t)(s->nbuckets * sizeof(LruEntry*)));
+        pthread_mutex_destroy(&s->lock);
+    }
+}
+
+// ---------- 操作 ----------
+
+SharedLru* shared_lru_create(GC* gc, size_t maxEntries, size_t maxBytes) {
+    if (!maxEntries && !maxBytes) return NULL;
+    SharedLru* lru = (SharedLru*)gc_create(gc, sizeof(SharedLru) - sizeof(GCObject));
+    if (!lru) return NULL;
+    lru->header.dtor = shared_lru_dtor;
+    lru->header.trace = shared_lru_trace;
+    gc_set_kind(&lru->header, SHARED_LRU_KIND);
+    lru->maxEntries = maxEntries;
+    lru->maxBytes = maxBytes;
+    // 每个分片至少容纳约 LRU_SHARD_MIN 个条目，否则分片内的淘汰顺序与全局LRU相差太远
+    size_t shards = LRU_SHARDS;
+    while (maxEntries && shards > 1 && maxEntries / shards < LRU_SHARD_MIN)
+        shards /= 2;
+    lru->shardMask = shards - 1;
+    for (int i = 0; i < LRU_SHARDS; i++) {
+        LruShard* s = &lru->shards[i];
+        pthread_mutex_init(&s->lock, NULL);   // 其余字段已由 gc_create 清零
+        s->list.next = s->list.prev = &s->list;
+    }
+    return lru;
+}
+
+// 从 skip 之后的分片依次淘汰最久未使用的条目，直到不再超出限额
+static void lru_evict_others(SharedLru* lru, size_t skip) {
+    GC* gc = lru->header.gc;
+    for (size_t i = 1; i <= lru->shardMask && lru_over(lru); i++) {
+        LruShard* s = &lru->shards[(skip + i) & lru->shardMask];
+        pthread_mutex_lock(&s->lock);
+        gc_mutate_begin(gc);
+        while (lru_over(lru) && s->list.prev != &s->list) {
+            shard_remove(lru, s, s->list.prev);
+            lru_count(&lru->evictions);
+        }
+        gc_mutate_end(gc);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+int shared_lru_put(SharedLru* lru, StoredObject* key, StoredObject* val) {
+    GC* gc = lru->header.gc;
+    size_t bytes = stored_footprint(key) + stored_footprint(val);
+    if (lru->maxBytes && bytes > lru->maxBytes) return -1;
+    size_t hash = stored_hash(key);
+    size_t idx = lru_shard_index(lru, hash);
+    LruShard* s = &lru->shards[idx];
+    int ok = 1;
+    lru_count(&lru->puts);
+    pthread_mutex_lock(&s->lock);
+    gc_mutate_begin(gc);
+    LruEntry* e = shard_find(s, key, hash);
+    if (e) {
+        StoredObject* old = e->val;
+        gc_retain((GCObject*)val);
+        e->val = val;
+        lru_adjust(lru, s, 0, bytes - e->bytes);
+        e->bytes = bytes;
+        gc_release((GCObject*)old);
+        list_unlink(e);
+        list_push_front(s, e);
+    } else if (shard_grow(lru, s) && (e = (LruEntry*)malloc(sizeof(LruEntry)))) {
+        gc_account(&lru->header, GC_MEM_TABLE, (ptrdiff_t)sizeof(LruEntry));
+        gc_retain((GCObject*)key);
+        gc_retain((GCObject*)val);
+        e->hash = hash;
+        e->bytes = bytes;
+        e->key = key;
+        e->val = val;
+        size_t b = lru_bucket(s, hash);
+        e->hnext = s->buckets[b];
+        s->buckets[b] = e;
+        list_push_front(s, e);
+        lru_adjust(lru, s, 1, bytes);
+    } else {
+        ok = 0;
+    }
+    // 先从本分片最久未使用的一端淘汰，保留刚放入的条目
+    while (lru_over(lru) && s->list.prev != &s->list && s->list.prev != e) {
+        shard_remove(lru, s, s->list.prev);
+        lru_count(&lru->evictions);
+    }
+    gc_mutate_end(gc);
+    pthread_mutex_unlock(&s->lock);
+    // 本分片不够时淘汰其他分片的（不同时持有两个分片的锁）
+    if (lru_over(lru))
+        lru_evict_others(lru, idx);
+    return ok;
+}
+
+StoredObject* shared_lru_get(SharedLru* lru, const StoredObject* key) {
+    size_t hash = stored_hash(key);
+    LruShard* s = lru_shard(lru, hash);
+    pthread_mutex_lock(&s->lock);
+    LruEntry* e = shard_find(s, key, hash);
+    StoredObject* val = NULL;
+    if (e) {
+        if (s->list.next != e) {
+            list_unlink(e);
+            list_push_front(s, e);
+        }
+        val = e->val;
+        // 增加引用要与收集互斥：收集不持有分片锁，试删除读引用计数的中途不能出现新引用
+        gc_mutate_begin(lru->header.gc);
+        gc_retain((GCObject*)val);
+        gc_mutate_end(lru->header.gc);
+    }
+    pthread_mutex_unlock(&s->lock);
+    lru_count(val ? &lru->hits : &lru->misses);
+    return val;
+}
+
+int shared_lru_delete(SharedLru* lru, const StoredObject* key) {
+    GC* gc = lru->header.gc;
+    size_t hash = stored_hash(key);
+    LruShard* s = lru_shard(lru, hash);
+    pthread_mutex_lock(&s->lock);
+    gc_mutate_begin(gc);
+    LruEntry* e = shard_find(s, key, hash);
+    if (e)
+        shard_remove(lru, s, e);
+    gc_mutate_end(gc);
+    pthread_mutex_unlock(&s->lock);
+    return e != NULL;
+}
+
+void shared_lru_clear(SharedLru* lru) {
+    GC* gc = lru->header.gc;
+    for (int i = 0; i < LRU_SHARDS; i++) {
+        LruShard* s = &lru->shards[i];
+        pthread_mutex_lock(&s->lock);
+        gc_mutate_begin(gc);
+        shard_free_all(lru, s);
+        memset(s->buckets, 0, s->nbuckets * sizeof(LruEntry*));
+        gc_mutate_end(gc);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+void shared_lru_get_stats(SharedLru* lru, SharedLruStats* out) {
+    out->count = atomic_load_explicit(&lru->count, memory_order_relaxed);
+    out->bytes = atomic_load_explicit(&lru->bytes, memory_order_relaxed);
+    out->maxEntries = lru->maxEntries;
+    out->maxBytes = lru->maxBytes;
+    out->hits = atomic_load_explicit(&lru->hits, memory_order_relaxed);
+    out->misses = atomic_load_explicit(&lru->misses, memory_order_relaxed);
+    out->puts = atomic_load_explicit(&lru->puts, memory_order_relaxed);
+    out->evictions = atomic_load_explicit(&lru->evictions, memory_order_relaxed);
+}
+
+// ---------- Lua 绑定 ----------
+
+SharedLru* check_shared_lru(lua_State* L, int idx) {
+    void* ud = luaL_checkudata(L, idx, SHARED_LRU_MT);
+    return *(SharedLru**)ud;
+}
+
+// xshare.lru(max_entries) 或 xshare.lru{entries = n, bytes = m}
+int l_shared_lru_new(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    lua_Integer entries = 0, bytes = 0;
+    if (lua_istable(L, 1)) {
+        lua_getfield(L, 1, "entries");
+        entries = luaL_optinteger(L, -1, 0);
+        lua_getfield(L, 1, "bytes");
+        bytes = luaL_optinteger(L, -1, 0);
+        lua_pop(L, 2);
+    } else {
+        entries = luaL_checkinteger(L, 1);
+    }
+    luaL_argcheck(L, entries >= 0 && bytes >= 0 && (entries || bytes), 1,
+                  "positive entry or byte limit expected");
+    SharedLru* lru = shared_lru_create(gc, (size_t)entries, (size_t)bytes);
+    if (!lru) return luaL_error(L, "cannot create lru cache");
+    SharedLru** ud = (SharedLru**)lua_newuserdata(L, sizeof(SharedLru*));
+    *ud = lru;
+    luaL_setmetatable(L, SHARED_LRU_MT);
+    stored_remember_object(L, -1);
+    return 1;
+}
+
+// lru:get(key) -> value 或 nil
+int l_shared_lru_get(lua_State* L) {
+    SharedLru* lru = check_shared_lru(L, 1);
+    StoredObject tmp;
+    StoredObject* key = stored_lookup_key(L, 2, &tmp, lru->header.gc);
+    if (!key) return luaL_error(L, "invalid key");
+    StoredObject* val = shared_lru_get(lru, key);
+    if (key != &tmp) gc_release((GCObject*)key);
+    if (!val) {
+        lua_pushnil(L);
+        return 1;
+    }
+    stored_push(L, val);
+    gc_release((GCObject*)val);
+    return 1;
+}
+
+// lru:put(key, value)，value 为 nil 时删除
+int l_shared_lru_put(lua_State* L) {
+    SharedLru* lru = check_shared_lru(L, 1);
+    luaL_argcheck(L, !lua_isnoneornil(L, 2), 2, "key must not be nil");
+    if (lua_isnoneornil(L, 3)) {
+        lua_settop(L, 2);
+        return l_shared_lru_delete(L);
+    }
+    StoredObject* key = stored_create_ex(L, 2, lru->header.gc);
+    StoredObject* val = stored_create_ex(L, 3, lru->header.gc);
+    if (!key || !val) {
+        if (key) gc_release((GCObject*)key);
+        if (val) gc_release((GCObject*)val);
+        return luaL_error(L, "invalid key or value");
+    }
+    int ok = shared_lru_put(lru, key, val);
+    gc_release((GCObject*)key);
+    gc_release((GCObject*)val);
+    if (ok < 0) return luaL_error(L, "entry exceeds the cache byte limit");
+    if (!ok) return luaL_error(L, "out of memory");
+    return 0;
+}
+
+// lru:delete(key) -> 是否存在
+int l_shared_lru_delete(lua_State* L) {
+    SharedLru* lru = check_shared_lru(L, 1);
+    StoredObject tmp;
+    StoredObject* key = stored_lookup_key(L, 2, &tmp, lru->header.gc);
+    if (!key) return luaL_error(L, "invalid key");
+    int found = shared_lru_delete(lru, key);
+    if (key != &tmp) gc_release((GCObject*)key);
+    lua_pushboolean(L, found);
+    return 1;
+}
+
+int l_shared_lru_clear(lua_State* L) {
+    shared_lru_clear(check_shared_lru(L, 1));
+    return 0;
+}
+
+int l_shared_lru_len(lua_State* L) {
+    SharedLruStats st;
+    shared_lru_get_stats(check_shared_lru(L, 1), &st);
+    lua_pushinteger(L, (lua_Integer)st.count);
+    return 1;
+}
+
+int l_shared_lru_stats(lua_State* L) {
+    SharedLruStats st;
+    shared_lru_get_stats(check_shared_lru(L, 1), &st);
+    size_t lookups = st.hits + st.misses;
+    lua_newtable(L);
+    lua_pushinteger(L, st.count);          lua_setfield(L, -2, "count");
+    lua_pushinteger(L, st.bytes);          lua_setfield(L, -2, "bytes");
+    lua_pushinteger(L, st.maxEntries);     lua_setfield(L, -2, "max_entries");
+    lua_pushinteger(L, st.maxBytes);       lua_setfield(L, -2, "max_bytes");
+    lua_pushinteger(L, st.hits);           lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, st.misses);         lua_setfield(L, -2, "misses");
+    lua_pushnumber(L, lookups ? (double)st.hits / lookups : 0);
+    lua_setfield(L, -2, "hit_ratio");
+    lua_pushinteger(L, st.puts);           lua_setfield(L, -2, "puts");
+    lua_pushinteger(L, st.evictions);      lua_setfield(L, -2, "evictions");
+    return 1;
+}
+
+int l_shared_lru_tostring(lua_State* L) {
+    lua_pushfstring(L, "xshare.lru: %p", check_shared_lru(L, 1));
+    return 1;
+}
+
+int l_shared_lru_gc(lua_State* L) {
+    SharedLru** ud = (SharedLru**)lua_touserdata(L, 1);
+    if (*ud) {
+        gc_release((GCObject*)(*ud));
+        *ud = NULL;
+    }
+    return 0;
+}
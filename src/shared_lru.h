@@ -0,0 +1,86 @@
+#ifndef SHARED_LRU_H
+#define SHARED_LRU_H
+
+#include <lua.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "GC.h"
+#include "stored_object.h"
+#include "shared_struct.h"
+
+// SharedLru 的GC对象种类
+#define SHARED_LRU_KIND (SHARED_RECORD_KIND + 1)
+
+// 最大分片数（2的幂）。每个分片各有一把锁、一张哈希表和一条最近使用链表
+#define LRU_SHARDS 16
+
+extern const char* SHARED_LRU_MT;
+
+typedef struct LruEntry {
+    struct LruEntry* hnext;           // 哈希链
+    struct LruEntry *prev, *next;     // 最近使用链表（分片内）
+    size_t hash;
+    size_t bytes;                     // 键和值占用的内存
+    StoredObject* key;
+    StoredObject* val;
+} LruEntry;
+
+typedef struct LruShard {
+    pthread_mutex_t lock;
+    LruEntry** buckets;
+    size_t nbuckets;                  // 2的幂，0 表示尚未分配
+    size_t count;
+    size_t bytes;
+    LruEntry list;                    // 哨兵：list.next 为最近使用，list.prev 为最久未使用
+} LruShard;
+
+/* 有界缓存：按条目数和/或字节数限制整个缓存，超出时先淘汰键所在分片中最久未使用的条目，
+ * 不够再依次淘汰其他分片的（近似全局LRU）。get/put/delete 都是 O(1)，只锁键所在的分片。
+ * 条目数限额较小时使用较少的分片。淘汰的键值交还给GC */
+typedef struct SharedLru {
+    GCObject header;
+    size_t maxEntries;                // 0 表示不限
+    size_t maxBytes;
+    size_t shardMask;                 // 使用的分片数减1
+    atomic_size_t count, bytes;       // 所有分片的合计，与限额比较
+    atomic_size_t hits, misses, puts, evictions;
+    LruShard shards[LRU_SHARDS];
+} SharedLru;
+
+typedef struct SharedLruStats {
+    size_t count, bytes;
+    size_t maxEntries, maxBytes;
+    size_t hits, misses, puts, evictions;
+} SharedLruStats;
+
+// 创建缓存。maxEntries、maxBytes 为0表示该项不限，但不能都为0
+SharedLru* shared_lru_create(GC* gc, size_t maxEntries, size_t maxBytes);
+
+// 放入键值（增加引用），替换已有的值，必要时淘汰最久未使用的条目。成功返回1，内存不足返回0；
+// 单个条目超过 maxBytes 时不放入（已有的值保持不变），返回-1
+int shared_lru_put(SharedLru* lru, StoredObject* key, StoredObject* val);
+
+// 查找并标记为最近使用。返回的值已增加引用，调用者用完需 gc_release；不存在返回NULL
+StoredObject* shared_lru_get(SharedLru* lru, const StoredObject* key);
+
+// 删除键，存在时返回1
+int shared_lru_delete(SharedLru* lru, const StoredObject* key);
+
+// 清空缓存（不计入淘汰次数）
+void shared_lru_clear(SharedLru* lru);
+
+void shared_lru_get_stats(SharedLru* lru, SharedLruStats* out);
+
+// 以下为Lua绑定函数
+SharedLru* check_shared_lru(lua_State* L, int idx);
+int l_shared_lru_new(lua_State* L);
+int l_shared_lru_get(lua_State* L);
+int l_shared_lru_put(lua_State* L);
+int l_shared_lru_delete(lua_State* L);
+int l_shared_lru_clear(lua_State* L);
+int l_shared_lru_len(lua_State* L);
+int l_shared_lru_stats(lua_State* L);
+int l_shared_lru_tostring(lua_State* L);
+int l_shared_lru_gc(lua_State* L);
+
+#endif
@@ -0,0 +1,340 @@
+#include "shared_pqueue.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include "lauxlib.h"
+
+const char* SHARED_PQUEUE_MT = "XShare.pqueue";
+
+#define PQ_POP_BATCH 64
+
+// 优先级比较：整数和浮点数之间按数值比较，其余按 stored_compare
+static int prio_compare(const StoredObject* a, const StoredObject* b) {
+    if (a->type != b->type &&
+        (a->type == STORED_INTEGER || a->type == STORED_NUMBER) &&
+        (b->type == STORED_INTEGER || b->type == STORED_NUMBER)) {
+        lua_Number x = a->type == STORED_INTEGER ? (lua_Number)a->data.integer_val : a->data.number_val;
+        lua_Number y = b->type == STORED_INTEGER ? (lua_Number)b->data.integer_val : b->data.number_val;
+        return x < y ? -1 : x > y ? 1 : 0;
+    }
+    return stored_compare(a, b);
+}
+
+// a 是否应排在 b 之前
+static inline int item_before(const SharedPQueue* pq, const PQueueItem* a, const PQueueItem* b) {
+    int c = prio_compare(a->prio, b->prio) * pq->order;
+    return c ? c < 0 : a->seq < b->seq;
+}
+
+// ---------- 二叉堆（持有队列锁且在 gc_mutate_begin 内） ----------
+
+static void sift_up(SharedPQueue* pq, size_t i) {
+    PQueueItem item = pq->items[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!item_before(pq, &item, &pq->items[parent])) break;
+        pq->items[i] = pq->items[parent];
+        i = parent;
+    }
+    pq->items[i] = item;
+}
+
+static void sift_down(SharedPQueue* pq, size_t i) {
+    PQueueItem item = pq->items[i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= pq->count) break;
+        if (child + 1 < pq->count && item_before(pq, &pq->items[child + 1], &pq->items[child]))
+            child++;
+        if (!item_before(pq, &pq->items[child], &item)) break;
+        pq->items[i] = pq->items[child];
+        i = child;
+    }
+    pq->items[i] = item;
+}
+
+static void heap_pop(SharedPQueue* pq, PQueueItem* out) {
+    *out = pq->items[0];
+    if (--pq->count > 0) {
+        pq->items[0] = pq->items[pq->count];
+        sift_down(pq, 0);
+    }
+}
+
+static int ensure_capacity(SharedPQueue* pq, size_t needed) {
+    if (needed <= pq->cap) return 1;
+    size_t newcap = pq->cap ? pq->cap * 2 : 16;
+    PQueueItem* items = (PQueueItem*)realloc(pq->items, newcap * sizeof(PQueueItem));
+    if (!items) return 0;
+    gc_account(&pq->header, GC_MEM_TABLE, (ptrdiff_t)((newcap - pq->cap) * sizeof(PQueueItem)));
+    pq->items = items;
+    pq->cap = newcap;
+    return 1;
+}
+
+// ---------- GC ----------
+
+static void shared_pqueue_trace(GCObject* obj, GCVisitor visit, void* ud) {
+    SharedPQueue* pq = (SharedPQueue*)obj;
+    for (size_t i = 0; i < pq->count; i++) {
+        visit((GCObject*)pq->items[i].prio, ud);
+        visit((GCObject*)pq->items[i].val, ud);
+    }
+}
+
+static void shared_pqueue_dtor(GCObject* obj) {
+    SharedPQueue* pq = (SharedPQueue*)obj;
+    for (size_t i = 0; i < pq->count; i++) {
+        gc_release((GCObject*)pq->items[i].prio);
+        gc_release((GCObject*)pq->items[i].val);
+    }
+    free(pq->items);
+    gc_account(obj, GC_MEM_TABLE, -(ptrdiff_t)(pq->cap * sizeof(PQueueItem)));
+    pthread_cond_destroy(&pq->nonempty);
+    pthread_mutex_destroy(&pq->lock);
+}
+
+// ---------- 操作 ----------
+
+SharedPQueue* shared_pqueue_create(GC* gc, int maxFirst) {
+    SharedPQueue* pq = (SharedPQueue*)gc_create(gc, sizeof(SharedPQueue) - sizeof(GCObject));
+    if (!pq) return NULL;
+    pq->header.dtor = shared_pqueue_dtor;
+    pq->header.trace = shared_pqueue_trace;
+    gc_set_kind(&pq->header, SHARED_PQUEUE_KIND);
+    pthread_mutex_init(&pq->lock, NULL);   // 其余字段已由 gc_create 清零
+    // 超时按单调时钟计算，不受系统时间调整影响
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pq->nonempty, &attr);
+    pthread_condattr_destroy(&attr);
+    pq->order = maxFirst ? -1 : 1;
+    return pq;
+}
+
+int shared_pqueue_push(SharedPQueue* pq, StoredObject* prio, StoredObject* val) {
+    GC* gc = pq->header.gc;
+    pthread_mutex_lock(&pq->lock);
+    gc_mutate_begin(gc);   // 扩容会移动堆数组，也要在内
+    if (!ensure_capacity(pq, pq->count + 1)) {
+        gc_mutate_end(gc);
+        pthread_mutex_unlock(&pq->lock);
+        return 0;
+    }
+    gc_retain((GCObject*)prio);
+    gc_retain((GCObject*)val);
+    PQueueItem* item = &pq->items[pq->count];
+    item->prio = prio;
+    item->val = val;
+    item->seq = pq->nextSeq++;
+    sift_up(pq, pq->count++);
+    gc_mutate_end(gc);
+    pthread_cond_signal(&pq->nonempty);
+    pthread_mutex_unlock(&pq->lock);
+    return 1;
+}
+
+size_t shared_pqueue_pop(SharedPQueue* pq, PQueueItem* out, size_t max, double timeout) {
+    GC* gc = pq->header.gc;
+    size_t n = 0;
+    pthread_mutex_lock(&pq->lock);
+    if (pq->count == 0 && timeout != 0) {
+        // 等待时不在 gc_mutate_begin 内，不阻塞收集
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        // 截止时间超出 time_t 范围的超时（以及NaN）按一直等待处理
+        double limit = (sizeof(time_t) < 8 ? 2147483647.0 : 9.2e18) - (double)deadline.tv_sec - 1;
+        if (timeout < 0 || !(timeout < limit)) {
+            while (pq->count == 0)
+                pthread_cond_wait(&pq->nonempty, &pq->lock);
+        } else {
+            double secs = deadline.tv_nsec / 1e9 + timeout;
+            deadline.tv_sec += (time_t)secs;
+            deadline.tv_nsec = (long)((secs - (time_t)secs) * 1e9);
+            while (pq->count == 0) {
+                if (pthread_cond_timedwait(&pq->nonempty, &pq->lock, &deadline) == ETIMEDOUT)
+                    break;
+            }
+        }
+    }
+    if (pq->count > 0 && max > 0) {
+        // 出队的引用直接转交给调用者，计数不变
+        gc_mutate_begin(gc);
+        while (n < max && pq->count > 0)
+            heap_pop(pq, &out[n++]);
+        gc_mutate_end(gc);
+        if (pq->count > 0)
+            pthread_cond_signal(&pq->nonempty);   // 还有剩余，接力唤醒下一个等待者
+    }
+    pthread_mutex_unlock(&pq->lock);
+    return n;
+}
+
+int shared_pqueue_peek(SharedPQueue* pq, PQueueItem* out) {
+    pthread_mutex_lock(&pq->lock);
+    int found = pq->count > 0;
+    if (found) {
+        *out = pq->items[0];
+        // 增加引用要与收集互斥：收集不持有队列锁，试删除读引用计数的中途不能出现新引用
+        gc_mutate_begin(pq->header.gc);
+        gc_retain((GCObject*)out->prio);
+        gc_retain((GCObject*)out->val);
+        gc_mutate_end(pq->header.gc);
+    }
+    pthread_mutex_unlock(&pq->lock);
+    return found;
+}
+
+size_t shared_pqueue_size(SharedPQueue* pq) {
+    pthread_mutex_lock(&pq->lock);
+    size_t n = pq->count;
+    pthread_mutex_unlock(&pq->lock);
+    return n;
+}
+
+void shared_pqueue_clear(SharedPQueue* pq) {
+    GC* gc = pq->header.gc;
+    pthread_mutex_lock(&pq->lock);
+    gc_mutate_begin(gc);
+    for (size_t i = 0; i < pq->count; i++) {
+        gc_release((GCObject*)pq->items[i].prio);
+        gc_release((GCObject*)pq->items[i].val);
+    }
+    pq->count = 0;
+    gc_mutate_end(gc);
+    pthread_mutex_unlock(&pq->lock);
+}
+
+// ---------- Lua 绑定 ----------
+
+SharedPQueue* check_shared_pqueue(lua_State* L, int idx) {
+    void* ud = luaL_checkudata(L, idx, SHARED_PQUEUE_MT);
+    return *(SharedPQueue**)ud;
+}
+
+// 超时参数：nil 为不等待，math.huge 为一直等待
+static double check_timeout(lua_State* L, int idx) {
+    if (lua_isnoneornil(L, idx)) return 0;
+    lua_Number t = luaL_checknumber(L, idx);
+    luaL_argcheck(L, t >= 0, idx, "timeout must be non-negative");
+    return isinf(t) ? -1 : (double)t;
+}
+
+static void push_item(lua_State* L, PQueueItem* item) {
+    stored_push(L, item->val);
+    stored_push(L, item->prio);
+    gc_release((GCObject*)item->val);
+    gc_release((GCObject*)item->prio);
+}
+
+// xshare.pqueue(["min" | "max"])
+int l_shared_pqueue_new(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    static const char* const orders[] = {"min", "max", NULL};
+    int maxFirst = luaL_checkoption(L, 1, "min", orders);
+    SharedPQueue* pq = shared_pqueue_create(gc, maxFirst);
+    if (!pq) return luaL_error(L, "cannot create priority queue");
+    SharedPQueue** ud = (SharedPQueue**)lua_newuserdata(L, sizeof(SharedPQueue*));
+    *ud = pq;
+    luaL_setmetatable(L, SHARED_PQUEUE_MT);
+    stored_remember_object(L, -1);
+    return 1;
+}
+
+// q:push(priority[, value])，value 省略时为 priority
+int l_shared_pqueue_push(lua_State* L) {
+    SharedPQueue* pq = check_shared_pqueue(L, 1);
+    luaL_argcheck(L, !lua_isnoneornil(L, 2), 2, "priority must not be nil");
+    if (lua_isnoneornil(L, 3)) {
+        lua_settop(L, 2);
+        lua_pushvalue(L, 2);
+    }
+    StoredObject* prio = stored_create_ex(L, 2, pq->header.gc);
+    StoredObject* val = stored_create_ex(L, 3, pq->header.gc);
+    if (!prio || !val) {
+        if (prio) gc_release((GCObject*)prio);
+        if (val) gc_release((GCObject*)val);
+        return luaL_error(L, "invalid priority or value");
+    }
+    int ok = shared_pqueue_push(pq, prio, val);
+    gc_release((GCObject*)prio);
+    gc_release((GCObject*)val);
+    if (!ok) return luaL_error(L, "out of memory");
+    return 0;
+}
+
+// q:pop([timeout]) -> value, priority 或 nil（队列为空且超时）
+int l_shared_pqueue_pop(lua_State* L) {
+    SharedPQueue* pq = check_shared_pqueue(L, 1);
+    double timeout = check_timeout(L, 2);
+    PQueueItem item;
+    if (!shared_pqueue_pop(pq, &item, 1, timeout)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    push_item(L, &item);
+    return 2;
+}
+
+// q:pop_n(n[, timeout]) -> { value, ... }, { priority, ... }
+// 一次加锁出队最多 n 个；队列为空时等待第一个元素，超时返回两个空表
+int l_shared_pqueue_pop_n(lua_State* L) {
+    SharedPQueue* pq = check_shared_pqueue(L, 1);
+    lua_Integer want = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, want >= 0, 2, "count must be non-negative");
+    double timeout = check_timeout(L, 3);
+    lua_settop(L, 3);
+    lua_createtable(L, want < PQ_POP_BATCH ? (int)want : PQ_POP_BATCH, 0);
+    lua_createtable(L, want < PQ_POP_BATCH ? (int)want : PQ_POP_BATCH, 0);
+    PQueueItem buf[PQ_POP_BATCH];
+    lua_Integer got = 0;
+    while (got < want) {
+        size_t max = (size_t)(want - got) < PQ_POP_BATCH ? (size_t)(want - got) : PQ_POP_BATCH;
+        size_t n = shared_pqueue_pop(pq, buf, max, got ? 0 : timeout);   // 只等待第一批
+        for (size_t i = 0; i < n; i++) {
+            push_item(L, &buf[i]);
+            lua_rawseti(L, 5, got + 1);
+            lua_rawseti(L, 4, ++got);
+        }
+        if (n < max) break;
+    }
+    return 2;
+}
+
+// q:peek() -> value, priority 或 nil
+int l_shared_pqueue_peek(lua_State* L) {
+    SharedPQueue* pq = check_shared_pqueue(L, 1);
+    PQueueItem item;
+    if (!shared_pqueue_peek(pq, &item)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    push_item(L, &item);
+    return 2;
+}
+
+int l_shared_pqueue_clear(lua_State* L) {
+    shared_pqueue_clear(check_shared_pqueue(L, 1));
+    return 0;
+}
+
+int l_shared_pqueue_len(lua_State* L) {
+    lua_pushinteger(L, (lua_Integer)shared_pqueue_size(check_shared_pqueue(L, 1)));
+    return 1;
+}
+
+int l_shared_pqueue_tostring(lua_State* L) {
+    lua_pushfstring(L, "xshare.pqueue: %p", check_shared_pqueue(L, 1));
+    return 1;
+}
+
+int l_shared_pqueue_gc(lua_State* L) {
+    SharedPQueue** ud = (SharedPQueue**)lua_touserdata(L, 1);
+    if (*ud) {
+        gc_release((GCObject*)(*ud));
+        *ud = NULL;
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef SHARED_PQUEUE_H
+#define SHARED_PQUEUE_H
+
+#include <lua.h>
+#include <pthread.h>
+#include <stdint.h>
+#include "GC.h"
+#include "stored_object.h"
+#include "shared_lru.h"
+
+// SharedPQueue 的GC对象种类
+#define SHARED_PQUEUE_KIND (SHARED_LRU_KIND + 1)
+
+extern const char* SHARED_PQUEUE_MT;
+
+typedef struct PQueueItem {
+    StoredObject* prio;
+    StoredObject* val;
+    uint64_t seq;              // 入队序号，优先级相同时先入先出
+} PQueueItem;
+
+/* 跨线程优先队列：一把互斥锁保护的二叉堆。push/pop 为 O(log n)，
+ * 队列为空时 pop 可以在条件变量上等待，直到有元素入队或超时 */
+typedef struct SharedPQueue {
+    GCObject header;
+    pthread_mutex_t lock;
+    pthread_cond_t nonempty;
+    int order;                 // 1 为最小优先，-1 为最大优先
+    size_t count;
+    size_t cap;
+    PQueueItem* items;
+    uint64_t nextSeq;
+} SharedPQueue;
+
+/* 创建队列，maxFirst 为真时优先级最大的先出队。
+ * 优先级按 stored_compare 比较，但整数和浮点数之间按数值比较 */
+SharedPQueue* shared_pqueue_create(GC* gc, int maxFirst);
+
+// 入队（增加优先级和值的引用），唤醒一个等待的 pop。内存不足时返回0
+int shared_pqueue_push(SharedPQueue* pq, StoredObject* prio, StoredObject* val);
+
+/* 出队最多 max 个元素，按优先顺序写入 out，返回个数。队列为空时最多等待 timeout 秒
+ * （0 不等待，负数或超出 time_t 范围时一直等待，按单调时钟计时），超时返回0。out 中的引用转交给调用者，用完需 gc_release */
+size_t shared_pqueue_pop(SharedPQueue* pq, PQueueItem* out, size_t max, double timeout);
+
+// 查看队首元素（增加引用，调用者用完需 gc_release），队列为空时返回0
+int shared_pqueue_peek(SharedPQueue* pq, PQueueItem* out);
+
+size_t shared_pqueue_size(SharedPQueue* pq);
+
+void shared_pqueue_clear(SharedPQueue* pq);
+
+// 以下为Lua绑定函数
+SharedPQueue* check_shared_pqueue(lua_State* L, int idx);
+int l_shared_pqueue_new(lua_State* L);
+int l_shared_pqueue_push(lua_State* L);
+int l_shared_pqueue_pop(lua_State* L);
+int l_shared_pqueue_pop_n(lua_State* L);
+int l_shared_pqueue_peek(lua_State* L);
+int l_shared_pqueue_clear(lua_State* L);
+int l_shared_pqueue_len(lua_State* L);
+int l_shared_pqueue_tostring(lua_State* L);
+int l_shared_pqueue_gc(lua_State* L);
+
+#endif
@@ -0,0 +1,475 @@
+#include "shared_struct.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sched.h>
+#include "lauxlib.h"
+
+const char* SHARED_SCHEMA_MT = "XShare.struct";
+const char* SHARED_RECORD_MT = "XShare.record";
+
+// 自旋多少次后让出CPU（持锁者可能在 gc_mutate_begin 中等待收集结束）
+#define RECORD_SPIN_LIMIT 64
+
+static size_t name_hash(const char* s, size_t len) {
+    size_t h = (size_t)14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= (size_t)1099511628211ULL;
+    }
+    return h;
+}
+
+// ---------- 结构描述 ----------
+
+// 字段名、长度和索引数组占用的内存
+static size_t schema_side_bytes(const SharedSchema* s) {
+    size_t bytes = s->nfields * (sizeof(char*) + sizeof(size_t)) + (s->indexMask + 1) * sizeof(int);
+    for (size_t i = 0; i < s->nfields; i++)
+        bytes += s->lens[i] + 1;
+    return bytes;
+}
+
+static void schema_free_fields(SharedSchema* s) {
+    if (s->names) {
+        for (size_t i = 0; i < s->nfields; i++)
+            free(s->names[i]);
+    }
+    free(s->names);
+    free(s->lens);
+    free(s->index);
+}
+
+static void shared_schema_dtor(GCObject* obj) {
+    SharedSchema* s = (SharedSchema*)obj;
+    gc_account(obj, GC_MEM_OTHER, -(ptrdiff_t)schema_side_bytes(s));
+    schema_free_fields(s);
+}
+
+int shared_schema_field(const SharedSchema* s, const char* name, size_t len) {
+    size_t pos = name_hash(name, len) & s->indexMask;
+    for (;;) {
+        int i = s->index[pos];
+        if (i < 0) return -1;
+        if (s->lens[i] == len && memcmp(s->names[i], name, len) == 0) return i;
+        pos = (pos + 1) & s->indexMask;
+    }
+}
+
+// 构建字段名与索引，字段名重复时返回0
+static int schema_build(SharedSchema* s, const char* const* names, size_t n) {
+    size_t cap = 4;
+    while (cap < n * 2) cap <<= 1;   // 装填因子不超过1/2
+    s->names = (char**)calloc(n, sizeof(char*));
+    s->lens = (size_t*)malloc(n * sizeof(size_t));
+    s->index = (int*)malloc(cap * sizeof(int));
+    if (!s->names || !s->lens || !s->index) return 0;
+    s->indexMask = cap - 1;
+    for (size_t i = 0; i < cap; i++) s->index[i] = -1;
+    for (size_t i = 0; i < n; i++) {
+        size_t len = strlen(names[i]);
+        s->nfields = i;    // 查找只看已加入的字段
+        if (shared_schema_field(s, names[i], len) >= 0) return 0;
+        s->names[i] = (char*)malloc(len + 1);
+        if (!s->names[i]) return 0;
+        memcpy(s->names[i], names[i], len + 1);
+        s->lens[i] = len;
+        size_t pos = name_hash(names[i], len) & s->indexMask;
+        while (s->index[pos] >= 0)
+            pos = (pos + 1) & s->indexMask;
+        s->index[pos] = (int)i;
+    }
+    s->nfields = n;
+    return 1;
+}
+
+SharedSchema* shared_schema_create(GC* gc, const char* const* names, size_t n) {
+    if (n == 0 || n > (size_t)INT_MAX / 2) return NULL;
+    SharedSchema tmp;
+    memset(&tmp, 0, sizeof(tmp));
+    if (!schema_build(&tmp, names, n)) {
+        tmp.nfields = n;   // names 由 calloc 清零，未分配的为NULL
+        schema_free_fields(&tmp);
+        return NULL;
+    }
+    SharedSchema* s = (SharedSchema*)gc_create(gc, sizeof(SharedSchema) - sizeof(GCObject));
+    if (!s) {
+        schema_free_fields(&tmp);
+        return NULL;
+    }
+    s->header.dtor = shared_schema_dtor;
+    s->header.flags |= GC_FLAG_LEAF;   // 没有出边
+    gc_set_kind(&s->header, SHARED_SCHEMA_KIND);
+    s->nfields = tmp.nfields;
+    s->names = tmp.names;
+    s->lens = tmp.lens;
+    s->index = tmp.index;
+    s->indexMask = tmp.indexMask;
+    gc_account(&s->header, GC_MEM_OTHER, (ptrdiff_t)schema_side_bytes(s));
+    return s;
+}
+
+// ---------- 记录 ----------
+
+static void record_lock(SharedRecord* r) {
+    int spins = 0;
+    while (atomic_flag_test_and_set_explicit(&r->lock, memory_order_acquire)) {
+        if (++spins >= RECORD_SPIN_LIMIT) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+static void record_unlock(SharedRecord* r) {
+    atomic_flag_clear_explicit(&r->lock, memory_order_release);
+}
+
+// 遍历结构描述和字段引用的对象（收集器持有写锁时调用，修改引用的写入者都在 gc_mutate_begin 内）
+static void shared_record_trace(GCObject* obj, GCVisitor visit, void* ud) {
+    SharedRecord* r = (SharedRecord*)obj;
+    if (!r->schema) return;
+    visit((GCObject*)r->schema, ud);
+    for (size_t i = 0; i < r->schema->nfields; i++) {
+        if (record_slot_is_object(&r->slots[i]))
+            visit((GCObject*)r->slots[i].v.obj, ud);
+    }
+}
+
+static void shared_record_dtor(GCObject* obj) {
+    SharedRecord* r = (SharedRecord*)obj;
+    if (!r->schema) return;
+    for (size_t i = 0; i < r->schema->nfields; i++) {
+        if (record_slot_is_object(&r->slots[i]))
+            gc_release((GCObject*)r->slots[i].v.obj);
+    }
+    gc_release((GCObject*)r->schema);
+}
+
+SharedRecord* shared_record_create(GC* gc, SharedSchema* s) {
+    size_t extra = sizeof(SharedRecord) - sizeof(GCObject) + s->nfields * sizeof(RecordSlot);
+    SharedRecord* r = (SharedRecord*)gc_create(gc, extra);
+    if (!r) return NULL;
+    r->header.dtor = shared_record_dtor;
+    r->header.trace = shared_record_trace;
+    gc_set_kind(&r->header, SHARED_RECORD_KIND);
+    atomic_flag_clear(&r->lock);
+    gc_retain((GCObject*)s);
+    gc_mutate_begin(gc);
+    r->schema = s;   // 槽已由 gc_create 清零（STORED_NIL）
+    gc_mutate_end(gc);
+    return r;
+}
+
+/* 内部：用 slot 替换第 i 个字段，slot 引用的对象的所有权转交给记录。
+ * 新旧值都是标量时只需记录锁，否则还要进入 gc_mutate_begin，使收集器看不到修改中途的槽 */
+static void record_store(SharedRecord* r, size_t i, const RecordSlot* slot) {
+    GC* gc = r->header.gc;
+    record_lock(r);
+    RecordSlot old = r->slots[i];
+    if (record_slot_is_object(&old) || record_slot_is_object(slot)) {
+        gc_mutate_begin(gc);
+        r->slots[i] = *slot;
+        gc_mutate_end(gc);
+    } else {
+        r->slots[i] = *slot;
+    }
+    record_unlock(r);
+    if (record_slot_is_object(&old))
+        gc_release((GCObject*)old.v.obj);
+}
+
+void shared_record_set(SharedRecord* r, size_t i, StoredObject* v) {
+    RecordSlot slot;
+    slot.type = v ? v->type : STORED_NIL;
+    switch (slot.type) {
+    case STORED_NIL:
+        break;
+    case STORED_BOOLEAN:
+        slot.v.boolean_val = v->data.boolean_val;
+        break;
+    case STORED_INTEGER:
+        slot.v.integer_val = v->data.integer_val;
+        break;
+    case STORED_NUMBER:
+        slot.v.number_val = v->data.number_val;
+        break;
+    default:
+        gc_retain((GCObject*)v);
+        slot.v.obj = v;
+        break;
+    }
+    record_store(r, i, &slot);
+}
+
+void shared_record_get(SharedRecord* r, size_t i, RecordSlot* out) {
+    record_lock(r);
+    *out = r->slots[i];
+    // 增加引用要与收集互斥：收集不持有记录锁，试删除读引用计数的中途不能出现新引用
+    if (record_slot_is_object(out)) {
+        gc_mutate_begin(r->header.gc);
+        gc_retain((GCObject*)out->v.obj);
+        gc_mutate_end(r->header.gc);
+    }
+    record_unlock(r);
+}
+
+int shared_record_add(SharedRecord* r, size_t i, const RecordSlot* delta, RecordSlot* out) {
+    record_lock(r);
+    RecordSlot cur = r->slots[i];
+    if (cur.type == STORED_NIL) {
+        cur.type = STORED_INTEGER;
+        cur.v.integer_val = 0;
+    }
+    if (cur.type == STORED_INTEGER && delta->type == STORED_INTEGER) {
+        // 整数溢出时回绕（与Lua相同）
+        cur.v.integer_val = (lua_Integer)((lua_Unsigned)cur.v.integer_val + (lua_Unsigned)delta->v.integer_val);
+    } else if ((cur.type == STORED_INTEGER || cur.type == STORED_NUMBER) &&
+               (delta->type == STORED_INTEGER || delta->type == STORED_NUMBER)) {
+        lua_Number a = cur.type == STORED_INTEGER ? (lua_Number)cur.v.integer_val : cur.v.number_val;
+        lua_Number b = delta->type == STORED_INTEGER ? (lua_Number)delta->v.integer_val : delta->v.number_val;
+        cur.type = STORED_NUMBER;
+        cur.v.number_val = a + b;
+    } else {
+        record_unlock(r);
+        return 0;
+    }
+    r->slots[i] = cur;   // 新旧值都是标量，不需要 gc_mutate_begin
+    record_unlock(r);
+    *out = cur;
+    return 1;
+}
+
+// ---------- Lua 绑定 ----------
+
+SharedSchema* check_shared_schema(lua_State* L, int idx) {
+    void* ud = luaL_checkudata(L, idx, SHARED_SCHEMA_MT);
+    return *(SharedSchema**)ud;
+}
+
+SharedRecord* check_shared_record(lua_State* L, int idx) {
+    void* ud = luaL_checkudata(L, idx, SHARED_RECORD_MT);
+    return *(SharedRecord**)ud;
+}
+
+// 按字段名取下标，未知字段报错
+static size_t check_field(lua_State* L, SharedRecord* r, int arg) {
+    size_t len;
+    const char* name = luaL_checklstring(L, arg, &len);
+    int i = shared_schema_field(r->schema, name, len);
+    if (i < 0) return (size_t)luaL_error(L, "unknown field '%s'", name);
+    return (size_t)i;
+}
+
+// 把 Lua 栈上 idx 处的值存入第 i 个字段
+static void record_store_lua(lua_State* L, SharedRecord* r, size_t i, int idx) {
+    RecordSlot slot;
+    switch (lua_type(L, idx)) {
+    case LUA_TNIL:
+        slot.type = STORED_NIL;
+        break;
+    case LUA_TBOOLEAN:
+        slot.type = STORED_BOOLEAN;
+        slot.v.boolean_val = lua_toboolean(L, idx);
+        break;
+    case LUA_TNUMBER:
+        if (lua_isinteger(L, idx)) {
+            slot.type = STORED_INTEGER;
+            slot.v.integer_val = lua_tointeger(L, idx);
+        } else {
+            slot.type = STORED_NUMBER;
+            slot.v.number_val = lua_tonumber(L, idx);
+        }
+        break;
+    default: {
+        StoredObject* obj = stored_create_ex(L, idx, r->header.gc);
+        if (!obj) {
+            luaL_error(L, "invalid value for field '%s'", r->schema->names[i]);
+            return;
+        }
+        slot.type = obj->type;
+        slot.v.obj = obj;   // 创建时持有的引用转交给记录
+        break;
+    }
+    }
+    record_store(r, i, &slot);
+}
+
+static void push_slot(lua_State* L, RecordSlot* slot) {
+    switch (slot->type) {
+    case STORED_NIL:
+        lua_pushnil(L);
+        break;
+    case STORED_BOOLEAN:
+        lua_pushboolean(L, slot->v.boolean_val);
+        break;
+    case STORED_INTEGER:
+        lua_pushinteger(L, slot->v.integer_val);
+        break;
+    case STORED_NUMBER:
+        lua_pushnumber(L, slot->v.number_val);
+        break;
+    default:
+        stored_push(L, slot->v.obj);
+        gc_release((GCObject*)slot->v.obj);
+        break;
+    }
+}
+
+// xshare.struct{ "id", "ts", ... } -> schema
+int l_shared_struct_new(lua_State* L) {
+    GC* gc = shared_table_upvalue_heap(L);
+    luaL_checktype(L, 1, LUA_TTABLE);
+    size_t n = (size_t)lua_rawlen(L, 1);
+    luaL_argcheck(L, n > 0, 1, "at least one field expected");
+    const char** names = (const char**)lua_newuserdata(L, n * sizeof(const char*));   // 出错时由Lua回收
+    for (size_t i = 0; i < n; i++) {
+        if (lua_rawgeti(L, 1, (lua_Integer)i + 1) != LUA_TSTRING)
+            return luaL_argerror(L, 1, "field names must be strings");
+        names[i] = lua_tostring(L, -1);   // 字符串仍被参数表引用
+        lua_pop(L, 1);
+    }
+    SharedSchema* s = shared_schema_create(gc, names, n);
+    if (!s) return luaL_argerror(L, 1, "duplicate field name or out of memory");
+    SharedSchema** ud = (SharedSchema**)lua_newuserdata(L, sizeof(SharedSchema*));
+    *ud = s;
+    luaL_setmetatable(L, SHARED_SCHEMA_MT);
+    stored_remember_object(L, -1);
+    return 1;
+}
+
+// schema([init]) -> record，init 中的键必须是字段名
+int l_shared_schema_call(lua_State* L) {
+    SharedSchema* s = check_shared_schema(L, 1);
+    int hasInit = !lua_isnoneornil(L, 2);
+    if (hasInit) luaL_checktype(L, 2, LUA_TTABLE);
+    SharedRecord* r = shared_record_create(s->header.gc, s);
+    if (!r) return luaL_error(L, "cannot create record");
+    SharedRecord** ud = (SharedRecord**)lua_newuserdata(L, sizeof(SharedRecord*));
+    *ud = r;
+    luaL_setmetatable(L, SHARED_RECORD_MT);
+    stored_remember_object(L, -1);
+    int rec = lua_gettop(L);
+    if (hasInit) {
+        lua_pushnil(L);
+        while (lua_next(L, 2) != 0) {
+            if (lua_type(L, -2) != LUA_TSTRING)
+                return luaL_argerror(L, 2, "keys must be field names");
+            size_t i = check_field(L, r, -2);
+            record_store_lua(L, r, i, -1);
+            lua_pop(L, 1);
+        }
+    }
+    lua_settop(L, rec);
+    return 1;
+}
+
+// schema.fields -> { "id", "ts", ... }
+int l_shared_schema_index(lua_State* L) {
+    SharedSchema* s = check_shared_schema(L, 1);
+    const char* key = lua_tostring(L, 2);
+    if (key && strcmp(key, "fields") == 0) {
+        lua_createtable(L, (int)s->nfields, 0);
+        for (size_t i = 0; i < s->nfields; i++) {
+            lua_pushlstring(L, s->names[i], s->lens[i]);
+            lua_rawseti(L, -2, (lua_Integer)i + 1);
+        }
+        return 1;
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+int l_shared_schema_len(lua_State* L) {
+    lua_pushinteger(L, (lua_Integer)check_shared_schema(L, 1)->nfields);
+    return 1;
+}
+
+int l_shared_schema_tostring(lua_State* L) {
+    SharedSchema* s = check_shared_schema(L, 1);
+    lua_pushfstring(L, "xshare.struct(%I fields): %p", (lua_Integer)s->nfields, s);
+    return 1;
+}
+
+int l_shared_schema_gc(lua_State* L) {
+    SharedSchema** ud = (SharedSchema**)lua_touserdata(L, 1);
+    if (*ud) {
+        gc_release((GCObject*)(*ud));
+        *ud = NULL;
+    }
+    return 0;
+}
+
+int l_shared_record_index(lua_State* L) {
+    SharedRecord* r = check_shared_record(L, 1);
+    RecordSlot slot;
+    shared_record_get(r, check_field(L, r, 2), &slot);
+    push_slot(L, &slot);
+    return 1;
+}
+
+int l_shared_record_newindex(lua_State* L) {
+    SharedRecord* r = check_shared_record(L, 1);
+    record_store_lua(L, r, check_field(L, r, 2), 3);
+    return 0;
+}
+
+// 按字段顺序遍历，跳过值为nil的字段
+static int record_next(lua_State* L) {
+    SharedRecord* r = check_shared_record(L, 1);
+    size_t i = lua_isnil(L, 2) ? 0 : check_field(L, r, 2) + 1;
+    for (; i < r->schema->nfields; i++) {
+        RecordSlot slot;
+        shared_record_get(r, i, &slot);
+        if (slot.type == STORED_NIL) continue;
+        lua_pushlstring(L, r->schema->names[i], r->schema->lens[i]);
+        push_slot(L, &slot);
+        return 2;
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+int l_shared_record_pairs(lua_State* L) {
+    check_shared_record(L, 1);
+    lua_pushcfunction(L, record_next);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+int l_shared_record_tostring(lua_State* L) {
+    lua_pushfstring(L, "xshare.record: %p", check_shared_record(L, 1));
+    return 1;
+}
+
+int l_shared_record_gc(lua_State* L) {
+    SharedRecord** ud = (SharedRecord**)lua_touserdata(L, 1);
+    if (*ud) {
+        gc_release((GCObject*)(*ud));
+        *ud = NULL;
+    }
+    return 0;
+}
+
+// xshare.incr(record, field[, delta]) -> 新值
+// 原子地给数值字段加上 delta（默认1），nil 字段视为0
+int l_shared_record_incr(lua_State* L) {
+    SharedRecord* r = check_shared_record(L, 1);
+    size_t i = check_field(L, r, 2);
+    RecordSlot delta, out;
+    if (lua_isnoneornil(L, 3)) {
+        delta.type = STORED_INTEGER;
+        delta.v.integer_val = 1;
+    } else if (lua_isinteger(L, 3)) {
+        delta.type = STORED_INTEGER;
+        delta.v.integer_val = lua_tointeger(L, 3);
+    } else {
+        delta.type = STORED_NUMBER;
+        delta.v.number_val = luaL_checknumber(L, 3);
+    }
+    if (!shared_record_add(r, i, &delta, &out))
+        return luaL_error(L, "field '%s' is not a number", r->schema->names[i]);
+    push_slot(L, &out);
+    return 1;
+}
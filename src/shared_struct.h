@@ -0,0 +1,87 @@
+#ifndef SHARED_STRUCT_H
+#define SHARED_STRUCT_H
+
+#include <lua.h>
+#include <stdatomic.h>
+#include "GC.h"
+#include "stored_object.h"
+#include "shared_array.h"
+
+// SharedSchema / SharedRecord 的GC对象种类
+#define SHARED_SCHEMA_KIND (SHARED_ARRAY_KIND + 1)
+#define SHARED_RECORD_KIND (SHARED_ARRAY_KIND + 2)
+
+extern const char* SHARED_SCHEMA_MT;
+extern const char* SHARED_RECORD_MT;
+
+/* 结构描述：一组固定的字段名。字段名在创建时建好哈希索引，
+ * 之后按名称访问只需一次哈希探测，记录中按下标存取 */
+typedef struct SharedSchema {
+    GCObject header;
+    size_t nfields;
+    char** names;            // 字段名（按声明顺序）
+    size_t* lens;
+    int* index;              // 开放寻址哈希表，存放字段下标，-1 为空
+    size_t indexMask;
+} SharedSchema;
+
+/* 记录的一个字段。nil、布尔和数值直接存放在槽中（不创建GC对象），其他值引用 StoredObject */
+typedef struct RecordSlot {
+    StoredType type;
+    union {
+        int boolean_val;
+        lua_Integer integer_val;
+        lua_Number number_val;
+        StoredObject* obj;
+    } v;
+} RecordSlot;
+
+/* 记录：按结构描述的字段下标存放槽，每个记录一个自旋锁保护槽的读写 */
+typedef struct SharedRecord {
+    GCObject header;
+    atomic_flag lock;
+    SharedSchema* schema;
+    RecordSlot slots[];
+} SharedRecord;
+
+// 槽是否引用 StoredObject
+static inline int record_slot_is_object(const RecordSlot* s) {
+    return s->type != STORED_NIL && s->type != STORED_BOOLEAN &&
+           s->type != STORED_INTEGER && s->type != STORED_NUMBER;
+}
+
+// 创建结构描述，字段名重复或内存不足时返回NULL
+SharedSchema* shared_schema_create(GC* gc, const char* const* names, size_t n);
+
+// 按名称查找字段下标，不存在返回-1
+int shared_schema_field(const SharedSchema* s, const char* name, size_t len);
+
+// 创建记录（所有字段为nil），记录持有结构描述的引用
+SharedRecord* shared_record_create(GC* gc, SharedSchema* s);
+
+// 设置第 i 个字段。标量值复制到槽中，其他值增加引用
+void shared_record_set(SharedRecord* r, size_t i, StoredObject* v);
+
+// 读取第 i 个字段到 out。out 引用 StoredObject 时已增加引用，调用者用完需 gc_release
+void shared_record_get(SharedRecord* r, size_t i, RecordSlot* out);
+
+// 原子地给数值字段加上 delta（nil 视为0），结果写入 out；字段不是数值时返回0
+int shared_record_add(SharedRecord* r, size_t i, const RecordSlot* delta, RecordSlot* out);
+
+// 以下为Lua绑定函数
+SharedSchema* check_shared_schema(lua_State* L, int idx);
+SharedRecord* check_shared_record(lua_State* L, int idx);
+int l_shared_struct_new(lua_State* L);
+int l_shared_schema_call(lua_State* L);
+int l_shared_schema_index(lua_State* L);
+int l_shared_schema_len(lua_State* L);
+int l_shared_schema_tostring(lua_State* L);
+int l_shared_schema_gc(lua_State* L);
+int l_shared_record_index(lua_State* L);
+int l_shared_record_newindex(lua_State* L);
+int l_shared_record_pairs(lua_State* L);
+int l_shared_record_tostring(lua_State* L);
+int l_shared_record_gc(lua_State* L);
+int l_shared_record_incr(lua_State* L);
+
+#endif
@@ -1,10 +1,238 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   // pthread_rwlock_clockwrlock
+#endif
 #include "shared_table.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
+#include <time.h>
 #include "GC.h"
+#include "trace.h"
 #include "lauxlib.h"  // 用于luaL_checkudata
 
+// ---------- 统计 ----------
+
+static atomic_int stats_global = 0;   // 所有表都启用统计
+
+static inline int stats_on(SharedTable* tbl) {
+    return atomic_load_explicit(&tbl->statsEnabled, memory_order_relaxed) ||
+           atomic_load_explicit(&stats_global, memory_order_relaxed);
+}
+
+static inline void stat_add(atomic_size_t* counter, size_t n) {
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+static inline size_t stat_get(atomic_size_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+// ---------- 事务 ----------
+
+static _Thread_local SharedTableTx* tls_tx = NULL;     // 当前线程最内层的事务
+static _Thread_local SharedTableTx* tls_tx_root = NULL;   // 最外层的事务，持有全部的锁
+
+// 当前线程是否已在事务中持有 tbl 的写锁（嵌套事务的表都属于最外层事务）
+static inline int tx_holds(SharedTable* tbl) {
+    SharedTableTx* tx = tls_tx_root;
+    if (!tx) return 0;
+    for (size_t i = 0; i < tx->count; i++) {
+        if (tx->tables[i] == tbl) return 1;
+    }
+    for (size_t i = 0; i < tx->joinedCount; i++) {
+        if (tx->joined[i] == tbl) return 1;
+    }
+    return 0;
+}
+
+// 加锁：启用统计或追踪时先尝试加锁，失败才计时阻塞等待。事务持有的表不再加锁
+static void table_rdlock(SharedTable* tbl) {
+    if (tx_holds(tbl)) return;
+    int stats = stats_on(tbl);
+    if (!stats && !trace_enabled()) {
+        pthread_rwlock_rdlock(&tbl->lock);
+        return;
+    }
+    if (pthread_rwlock_tryrdlock(&tbl->lock) == 0) return;
+    uint64_t start = trace_now();
+    pthread_rwlock_rdlock(&tbl->lock);
+    uint64_t waited = trace_now() - start;
+    if (stats) {
+        stat_add(&tbl->stats.readWaits, 1);
+        stat_add(&tbl->stats.readWaitNs, waited);
+    }
+    trace_slow("table.rdlock", "lock", start, waited, NULL, 0);
+}
+
+static void table_wrlock(SharedTable* tbl) {
+    if (tx_holds(tbl)) return;
+    int stats = stats_on(tbl);
+    if (!stats && !trace_enabled()) {
+        pthread_rwlock_wrlock(&tbl->lock);
+        return;
+    }
+    if (pthread_rwlock_trywrlock(&tbl->lock) == 0) return;
+    uint64_t start = trace_now();
+    pthread_rwlock_wrlock(&tbl->lock);
+    uint64_t waited = trace_now() - start;
+    if (stats) {
+        stat_add(&tbl->stats.writeWaits, 1);
+        stat_add(&tbl->stats.writeWaitNs, waited);
+    }
+    trace_slow("table.wrlock", "lock", start, waited, NULL, 0);
+}
+
+static inline void table_unlock(SharedTable* tbl) {
+    if (tx_holds(tbl)) return;
+    pthread_rwlock_unlock(&tbl->lock);
+}
+
+static int compare_table_addr(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)*(SharedTable* const*)a;
+    uintptr_t y = (uintptr_t)*(SharedTable* const*)b;
+    return x < y ? -1 : x > y;
+}
+
+int shared_table_tx_begin(SharedTableTx* tx, SharedTable** tables, size_t n) {
+    // 按地址排序并去重：所有事务以同一顺序加锁，不会互相死锁
+    qsort(tables, n, sizeof(SharedTable*), compare_table_addr);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (count == 0 || tables[count - 1] != tables[i])
+            tables[count++] = tables[i];
+    }
+    if (tls_tx) {
+        // 嵌套事务：再加锁会破坏加锁顺序，只允许使用外层已持有的表
+        for (size_t i = 0; i < count; i++) {
+            if (!tx_holds(tables[i])) return 0;
+        }
+    } else {
+        for (size_t i = 0; i < count; i++)
+            table_wrlock(tables[i]);
+    }
+    tx->tables = tables;
+    tx->count = count;
+    tx->joined = NULL;
+    tx->joinedCount = tx->joinedCap = 0;
+    tx->outer = tls_tx;
+    tls_tx = tx;
+    if (!tx->outer) tls_tx_root = tx;
+    return 1;
+}
+
+void shared_table_tx_end(SharedTableTx* tx) {
+    assert(tls_tx == tx);
+    tls_tx = tx->outer;
+    if (!tx->outer) {
+        tls_tx_root = NULL;
+        for (size_t i = tx->joinedCount; i > 0; i--) {
+            SharedTable* tbl = tx->joined[i - 1];
+            pthread_rwlock_unlock(&tbl->lock);
+            gc_release((GCObject*)tbl);
+        }
+        free(tx->joined);
+        for (size_t i = tx->count; i > 0; i--)
+            table_unlock(tx->tables[i - 1]);
+    }
+}
+
+// 事务中等待其他表的写锁的最长时间（纳秒），超过即认为可能死锁
+static atomic_uint_fast64_t tx_join_timeout = 100000000u;
+
+void shared_table_set_tx_timeout(double seconds) {
+    uint64_t ns = seconds > 0 ? (seconds >= 1.8e10 ? UINT64_MAX / 2 : (uint64_t)(seconds * 1e9)) : 0;
+    atomic_store(&tx_join_timeout, ns);
+}
+
+double shared_table_get_tx_timeout(void) {
+    return atomic_load(&tx_join_timeout) / 1e9;
+}
+
+// 单调时钟（纳秒），不受系统时间调整影响（事务等待和TTL使用，与追踪的时钟无关）
+static uint64_t mono_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#if defined(__USE_GNU) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+#define HAVE_RWLOCK_CLOCKWRLOCK 1
+#endif
+
+// 内部：在 timeout 纳秒内取得写锁，成功返回1。截止时间按单调时钟计算，系统时间被调整不影响等待时长
+static int wrlock_within(pthread_rwlock_t* lock, uint64_t timeout) {
+    if (pthread_rwlock_trywrlock(lock) == 0) return 1;
+    if (timeout == 0) return 0;
+    uint64_t deadline = mono_clock() + timeout;
+#ifdef HAVE_RWLOCK_CLOCKWRLOCK
+    struct timespec ts = { (time_t)(deadline / 1000000000u), (long)(deadline % 1000000000u) };
+    return pthread_rwlock_clockwrlock(lock, CLOCK_MONOTONIC, &ts) == 0;
+#else
+    // 没有按时钟等待的接口：反复尝试，间隔从 50 微秒倍增到 1 毫秒
+    long pause = 50000;
+    for (;;) {
+        uint64_t now = mono_clock();
+        if (now >= deadline) return 0;
+        uint64_t left = deadline - now;
+        struct timespec ts = { 0, (long)(left < (uint64_t)pause ? left : (uint64_t)pause) };
+        nanosleep(&ts, NULL);
+        if (pthread_rwlock_trywrlock(lock) == 0) return 1;
+        if (pause < 1000000) pause *= 2;
+    }
+#endif
+}
+
+int shared_table_tx_join(SharedTable* tbl) {
+    SharedTableTx* tx = tls_tx_root;
+    if (!tx || tx_holds(tbl)) return 1;
+    if (tx->joinedCount == tx->joinedCap) {
+        size_t cap = tx->joinedCap ? tx->joinedCap * 2 : 4;
+        SharedTable** joined = (SharedTable**)realloc(tx->joined, cap * sizeof(SharedTable*));
+        if (!joined) return -1;
+        tx->joined = joined;
+        tx->joinedCap = cap;
+    }
+    // 这张表不在事务的加锁顺序中，不能无限等待：持有它的线程可能正在等本事务的表
+    if (!wrlock_within(&tbl->lock, atomic_load(&tx_join_timeout))) return 0;
+    gc_retain((GCObject*)tbl);   // 持有到事务结束，期间表可能被丢弃
+    tx->joined[tx->joinedCount++] = tbl;
+    return 1;
+}
+
+// 修改后递增版本号（持有写锁）
+static inline void table_bump(SharedTable* tbl) {
+    atomic_fetch_add_explicit(&tbl->version, 1, memory_order_release);
+}
+
+// 记录一次操作（counter 为 tbl->stats 中的字段）
+#define TABLE_COUNT(tbl, field) \
+    do { if (stats_on(tbl)) stat_add(&(tbl)->stats.field, 1); } while (0)
+
+void shared_table_enable_stats(SharedTable* tbl, int enable) {
+    if (tbl)
+        atomic_store(&tbl->statsEnabled, enable ? 1 : 0);
+    else
+        atomic_store(&stats_global, enable ? 1 : 0);
+}
+
+void shared_table_get_stats(SharedTable* tbl, SharedTableStats* out) {
+    SharedTableCounters* c = &tbl->stats;
+    out->enabled = stats_on(tbl);
+    out->reads = stat_get(&c->reads);
+    out->writes = stat_get(&c->writes);
+    out->deletes = stat_get(&c->deletes);
+    out->readWaits = stat_get(&c->readWaits);
+    out->writeWaits = stat_get(&c->writeWaits);
+    out->readWaitTime = stat_get(&c->readWaitNs) / 1e9;
+    out->writeWaitTime = stat_get(&c->writeWaitNs) / 1e9;
+    out->hits = stat_get(&c->hits);
+    out->misses = stat_get(&c->misses);
+    out->peakSize = stat_get(&c->peakSize);
+    out->resizes = stat_get(&c->resizes);
+    out->size = shared_table_size(tbl);
+}
+
 // 内部：查找键的索引，返回-1表示未找到
 static int find_key_index(SharedTable* tbl, StoredObject* key) {
     for (size_t i = 0; i < tbl->entries.size; i++) {
@@ -14,6 +242,267 @@ static int find_key_index(SharedTable* tbl, StoredObject* key) {
     return -1;
 }
 
+// ---------- 过期 ----------
+
+#define HEAP_NONE ((size_t)-1)
+#define EXPIRE_STEP 4          // 每次写操作顺带移除的过期条目数上限
+
+/* 过期最小堆：heap 存放条目下标，按 entries.expires 排序；pos 记录每个条目在堆中的位置（HEAP_NONE 为不在堆中）。
+ * 删除条目时按位置从堆中移除，堆中不会留下失效的项。heap 和 pos 与条目数组容量相同 */
+struct TableExpiry {
+    uint64_t defaultTtl;       // 纳秒，0 表示不过期
+    size_t count;
+    size_t* heap;
+    size_t* pos;
+};
+
+// 每个条目占用的内存（键、值，启用TTL后还有过期时间和堆位置）
+static size_t entry_bytes(SharedTable* tbl) {
+    size_t n = 2 * sizeof(StoredObject*);
+    if (tbl->expiry) n += sizeof(uint64_t) + 2 * sizeof(size_t);
+    return n;
+}
+
+// 秒转换为纳秒，ttl <= 0 为0（不过期）
+static uint64_t ttl_to_ns(double ttl) {
+    if (!(ttl > 0)) return 0;
+    double ns = ttl * 1e9;
+    if (ns >= 1.8e19) return UINT64_MAX / 2;
+    return ns < 1 ? 1 : (uint64_t)ns;
+}
+
+// 当前时间，未启用TTL时为0（不读时钟）
+static inline uint64_t table_clock(SharedTable* tbl) {
+    return tbl->expiry ? mono_clock() : 0;
+}
+
+// 第 i 个条目在 now 时是否可见（未过期）
+static inline int entry_live(SharedTable* tbl, size_t i, uint64_t now) {
+    if (!tbl->expiry) return 1;
+    uint64_t when = tbl->entries.expires[i];
+    return when == 0 || when > now;
+}
+
+// ---------- 变更日志 ----------
+
+typedef struct TableChangeEntry {
+    size_t seq;
+    StoredObject* key;     // 持有引用
+    StoredObject* val;     // 这次写入的值（持有引用），删除时为NULL
+    uint64_t expires;      // 写入的值的过期时间（0 为不过期）
+    int deleted;
+} TableChangeEntry;
+
+struct TableChangeLog {
+    size_t capacity;
+    size_t first;          // 日志中最旧一条的序号（空日志时为 changeSeq + 1）
+    TableChangeEntry entries[];   // 序号 seq 存放在 entries[seq % capacity]
+};
+
+static size_t changelog_bytes(size_t capacity) {
+    return sizeof(TableChangeLog) + capacity * sizeof(TableChangeEntry);
+}
+
+// 释放一条变更持有的引用
+static void changelog_release(TableChangeEntry* e) {
+    gc_release((GCObject*)e->key);
+    if (e->val) gc_release((GCObject*)e->val);
+}
+
+// 释放日志中键和值的引用并释放日志（持有写锁，调用者负责 gc_mutate_begin）
+static void changelog_free(SharedTable* tbl, TableChangeLog* log) {
+    for (size_t seq = log->first; seq <= tbl->changeSeq; seq++)
+        changelog_release(&log->entries[seq % log->capacity]);
+    gc_account(&tbl->header, GC_MEM_TABLE, -(ptrdiff_t)changelog_bytes(log->capacity));
+    free(log);
+}
+
+/* 追加一条变更（持有写锁且在 gc_mutate_begin 内）。val 为写入的值（删除时为NULL），
+ * 与键一起记入日志，读取变更时不需要再在表中查找键 */
+static void changelog_append(SharedTable* tbl, StoredObject* key, StoredObject* val, uint64_t expires) {
+    TableChangeLog* log = tbl->changes;
+    if (!log) return;
+    size_t seq = ++tbl->changeSeq;
+    TableChangeEntry* e = &log->entries[seq % log->capacity];
+    if (seq - log->first >= log->capacity) {   // 覆盖最旧的一条
+        changelog_release(e);
+        log->first++;
+    }
+    gc_retain((GCObject*)key);
+    if (val) gc_retain((GCObject*)val);
+    e->seq = seq;
+    e->key = key;
+    e->val = val;
+    e->expires = expires;
+    e->deleted = val == NULL;
+}
+
+int shared_table_enable_changes(SharedTable* tbl, size_t capacity) {
+    TableChangeLog* log = NULL;
+    if (capacity > 0) {
+        log = (TableChangeLog*)malloc(changelog_bytes(capacity));
+        if (!log) return 0;
+        log->capacity = capacity;
+    }
+    GC* gc = tbl->header.gc;
+    table_wrlock(tbl);
+    gc_mutate_begin(gc);
+    if (tbl->changes)
+        changelog_free(tbl, tbl->changes);
+    if (log) {
+        log->first = tbl->changeSeq + 1;   // 启用前的变更不在日志中
+        gc_account(&tbl->header, GC_MEM_TABLE, (ptrdiff_t)changelog_bytes(capacity));
+    }
+    tbl->changes = log;
+    gc_mutate_end(gc);
+    table_unlock(tbl);
+    return 1;
+}
+
+long shared_table_changes(SharedTable* tbl, size_t since, SharedTableChange* out, size_t max, size_t* last) {
+    long n = 0;
+    table_rdlock(tbl);
+    TABLE_COUNT(tbl, reads);
+    TableChangeLog* log = tbl->changes;
+    uint64_t now = table_clock(tbl);
+    *last = tbl->changeSeq;
+    if (!log || since + 1 < log->first || since > tbl->changeSeq) {
+        n = -1;
+        goto out;
+    }
+    // 增加引用要在 gc_mutate_begin 内：收集不持有表锁，试删除读引用计数的中途不能出现新引用
+    gc_mutate_begin(tbl->header.gc);
+    for (size_t seq = since + 1; seq <= tbl->changeSeq && (size_t)n < max; seq++, n++) {
+        TableChangeEntry* e = &log->entries[seq % log->capacity];
+        out[n].seq = seq;
+        out[n].key = e->key;
+        out[n].val = e->val && (e->expires == 0 || e->expires > now) ? e->val : NULL;
+        out[n].deleted = e->deleted;
+        gc_retain((GCObject*)out[n].key);
+        if (out[n].val) gc_retain((GCObject*)out[n].val);
+    }
+    gc_mutate_end(tbl->header.gc);
+out:
+    table_unlock(tbl);
+    return n;
+}
+
+static inline int heap_less(SharedTable* tbl, size_t a, size_t b) {
+    size_t* heap = tbl->expiry->heap;
+    return tbl->entries.expires[heap[a]] < tbl->entries.expires[heap[b]];
+}
+
+static inline void heap_swap(TableExpiry* ex, size_t a, size_t b) {
+    size_t t = ex->heap[a];
+    ex->heap[a] = ex->heap[b];
+    ex->heap[b] = t;
+    ex->pos[ex->heap[a]] = a;
+    ex->pos[ex->heap[b]] = b;
+}
+
+static void heap_fix(SharedTable* tbl, size_t i) {
+    TableExpiry* ex = tbl->expiry;
+    while (i > 0 && heap_less(tbl, i, (i - 1) / 2)) {
+        heap_swap(ex, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        size_t l = 2 * i + 1, m = i;
+        if (l < ex->count && heap_less(tbl, l, m)) m = l;
+        if (l + 1 < ex->count && heap_less(tbl, l + 1, m)) m = l + 1;
+        if (m == i) break;
+        heap_swap(ex, i, m);
+        i = m;
+    }
+}
+
+// 设置第 idx 个条目的过期时间并调整堆（持有写锁，已启用TTL）
+static void expiry_update(SharedTable* tbl, size_t idx, uint64_t when) {
+    TableExpiry* ex = tbl->expiry;
+    size_t p = ex->pos[idx];
+    tbl->entries.expires[idx] = when;
+    if (p == HEAP_NONE) {
+        if (!when) return;
+        p = ex->count++;
+        ex->heap[p] = idx;
+        ex->pos[idx] = p;
+    } else if (!when) {
+        heap_swap(ex, p, --ex->count);
+        ex->pos[idx] = HEAP_NONE;
+        if (p == ex->count) return;
+    }
+    heap_fix(tbl, p);
+}
+
+// 首次使用TTL时分配过期数据（持有写锁）
+static int expiry_enable(SharedTable* tbl) {
+    if (tbl->expiry) return 1;
+    size_t cap = tbl->entries.cap;
+    TableExpiry* ex = (TableExpiry*)malloc(sizeof(TableExpiry));
+    uint64_t* expires = cap ? (uint64_t*)malloc(cap * sizeof(uint64_t)) : NULL;
+    size_t* heap = cap ? (size_t*)malloc(cap * sizeof(size_t)) : NULL;
+    size_t* pos = cap ? (size_t*)malloc(cap * sizeof(size_t)) : NULL;
+    if (!ex || (cap && (!expires || !heap || !pos))) {
+        free(ex); free(expires); free(heap); free(pos);
+        return 0;
+    }
+    for (size_t i = 0; i < tbl->entries.size; i++) {
+        expires[i] = 0;
+        pos[i] = HEAP_NONE;
+    }
+    ex->defaultTtl = 0;
+    ex->count = 0;
+    ex->heap = heap;
+    ex->pos = pos;
+    tbl->entries.expires = expires;
+    tbl->expiry = ex;
+    gc_account(&tbl->header, GC_MEM_TABLE,
+               (ptrdiff_t)(sizeof(TableExpiry) + cap * (sizeof(uint64_t) + 2 * sizeof(size_t))));
+    return 1;
+}
+
+// 移除第 idx 个条目：最后一个条目移到该位置（持有写锁且在 gc_mutate_begin 内）
+static void remove_at(SharedTable* tbl, size_t idx) {
+    StoredObject* oldKey = tbl->entries.keys[idx];
+    StoredObject* oldVal = tbl->entries.vals[idx];
+    size_t last = tbl->entries.size - 1;
+    tbl->entries.keys[idx] = tbl->entries.keys[last];
+    tbl->entries.vals[idx] = tbl->entries.vals[last];
+    if (tbl->expiry) {
+        TableExpiry* ex = tbl->expiry;
+        expiry_update(tbl, idx, 0);
+        tbl->entries.expires[idx] = tbl->entries.expires[last];
+        ex->pos[idx] = ex->pos[last];
+        if (ex->pos[idx] != HEAP_NONE)
+            ex->heap[ex->pos[idx]] = idx;
+    }
+    tbl->entries.size--;
+    changelog_append(tbl, oldKey, NULL, 0);
+    table_bump(tbl);
+    // 释放键和值的引用
+    gc_release((GCObject*)oldKey);
+    gc_release((GCObject*)oldVal);
+}
+
+/* 以堆中第 i 项为根的子树里在 now 之前过期的条目数。子树的根未过期时整个子树都未过期，
+ * 所以只访问已过期的项（和它们的子节点），代价与过期条目数成正比（持有读锁或写锁） */
+static size_t count_expired(SharedTable* tbl, size_t i, uint64_t now) {
+    TableExpiry* ex = tbl->expiry;
+    if (i >= ex->count || tbl->entries.expires[ex->heap[i]] > now) return 0;
+    return 1 + count_expired(tbl, 2 * i + 1, now) + count_expired(tbl, 2 * i + 2, now);
+}
+
+// 按过期时间顺序移除最多 max 个在 now 之前过期的条目（持有写锁且在 gc_mutate_begin 内）
+static size_t expire_some(SharedTable* tbl, uint64_t now, size_t max) {
+    TableExpiry* ex = tbl->expiry;
+    size_t n = 0;
+    while (ex && n < max && ex->count > 0 && tbl->entries.expires[ex->heap[0]] <= now) {
+        remove_at(tbl, ex->heap[0]);
+        n++;
+    }
+    return n;
+}
+
 // 内部：确保数组容量
 static int ensure_capacity(SharedTable* tbl, size_t needed) {
     if (needed <= tbl->entries.cap) return 1;
@@ -21,17 +510,49 @@ static int ensure_capacity(SharedTable* tbl, size_t needed) {
     while (newcap < needed) newcap *= 2;
     StoredObject** newkeys = realloc(tbl->entries.keys, newcap * sizeof(StoredObject*));
     if (!newkeys) return 0;
+    tbl->entries.keys = newkeys;   // 旧数组可能已被realloc释放，立即更新
     StoredObject** newvals = realloc(tbl->entries.vals, newcap * sizeof(StoredObject*));
-    if (!newvals) {
-        free(newkeys);
-        return 0;
-    }
-    tbl->entries.keys = newkeys;
+    if (!newvals) return 0;        // 键数组变大无妨，容量仍按旧值计
     tbl->entries.vals = newvals;
+    TableExpiry* ex = tbl->expiry;
+    if (ex) {
+        uint64_t* newexp = realloc(tbl->entries.expires, newcap * sizeof(uint64_t));
+        if (!newexp) return 0;
+        tbl->entries.expires = newexp;
+        size_t* newheap = realloc(ex->heap, newcap * sizeof(size_t));
+        if (!newheap) return 0;
+        ex->heap = newheap;
+        size_t* newpos = realloc(ex->pos, newcap * sizeof(size_t));
+        if (!newpos) return 0;
+        ex->pos = newpos;
+    }
+    gc_account(&tbl->header, GC_MEM_TABLE,
+               (ptrdiff_t)((newcap - tbl->entries.cap) * entry_bytes(tbl)));
     tbl->entries.cap = newcap;
+    TABLE_COUNT(tbl, resizes);
     return 1;
 }
 
+// 遍历键、值和元表（收集器持有写锁时调用，修改者都在 gc_mutate_begin 内，无需表锁）
+static void shared_table_trace(GCObject* obj, GCVisitor visit, void* ud) {
+    SharedTable* tbl = (SharedTable*)obj;
+    for (size_t i = 0; i < tbl->entries.size; i++) {
+        visit((GCObject*)tbl->entries.keys[i], ud);
+        visit((GCObject*)tbl->entries.vals[i], ud);
+    }
+    if (tbl->metatable)
+        visit((GCObject*)tbl->metatable, ud);
+    TableChangeLog* log = tbl->changes;
+    if (log) {
+        for (size_t seq = log->first; seq <= tbl->changeSeq; seq++) {
+            TableChangeEntry* e = &log->entries[seq % log->capacity];
+            visit((GCObject*)e->key, ud);
+            if (e->val)
+                visit((GCObject*)e->val, ud);
+        }
+    }
+}
+
 // 析构函数
 static void shared_table_dtor(GCObject* obj) {
     SharedTable* tbl = (SharedTable*)obj;
@@ -42,8 +563,18 @@ static void shared_table_dtor(GCObject* obj) {
     }
     free(tbl->entries.keys);
     free(tbl->entries.vals);
+    gc_account(obj, GC_MEM_TABLE, -(ptrdiff_t)(tbl->entries.cap * entry_bytes(tbl)));
+    if (tbl->expiry) {
+        free(tbl->entries.expires);
+        free(tbl->expiry->heap);
+        free(tbl->expiry->pos);
+        free(tbl->expiry);
+        gc_account(obj, GC_MEM_TABLE, -(ptrdiff_t)sizeof(TableExpiry));
+    }
     if (tbl->metatable)
         gc_release((GCObject*)tbl->metatable);
+    if (tbl->changes)
+        changelog_free(tbl, tbl->changes);
     pthread_rwlock_destroy(&tbl->lock);
 }
 
@@ -51,76 +582,163 @@ SharedTable* shared_table_create(GC* gc) {
     SharedTable* tbl = (SharedTable*)gc_create(gc, sizeof(SharedTable) - sizeof(GCObject));
     if (!tbl) return NULL;
     tbl->header.dtor = shared_table_dtor;
-    pthread_rwlock_init(&tbl->lock, NULL);
+    tbl->header.trace = shared_table_trace;
+    gc_set_kind(&tbl->header, SHARED_TABLE_KIND);
+    pthread_rwlock_init(&tbl->lock, NULL);   // 统计计数器已由 gc_create 清零
     tbl->entries.keys = NULL;
     tbl->entries.vals = NULL;
     tbl->entries.cap = 0;
     tbl->entries.size = 0;
     tbl->metatable = NULL;
+    tbl->changes = NULL;
+    tbl->entries.expires = NULL;
+    tbl->expiry = NULL;
     return tbl;
 }
 
-int shared_table_set(SharedTable* tbl, StoredObject* key, StoredObject* val) {
-    pthread_rwlock_wrlock(&tbl->lock);
+/* 内部：设置键值对。ttl 为纳秒，0 表示不过期；useDefault 时使用表的默认TTL。
+ * 写入前顺带移除少量已过期的条目 */
+static int table_set(SharedTable* tbl, StoredObject* key, StoredObject* val, uint64_t ttl, int useDefault) {
+    GC* gc = tbl->header.gc;
+    table_wrlock(tbl);
+    TABLE_COUNT(tbl, writes);
+    if (ttl && !expiry_enable(tbl)) {
+        table_unlock(tbl);
+        return 0;
+    }
+    if (useDefault && tbl->expiry)
+        ttl = tbl->expiry->defaultTtl;
+    gc_mutate_begin(gc);
+    uint64_t now = table_clock(tbl);
+    expire_some(tbl, now, EXPIRE_STEP);
     int idx = find_key_index(tbl, key);
     if (idx >= 0) {
-        // 替换：释放旧值，设置新值
-        gc_release((GCObject*)tbl->entries.vals[idx]);
+        // 替换：持有新值，释放旧值
+        StoredObject* old = tbl->entries.vals[idx];
+        gc_retain((GCObject*)val);
         tbl->entries.vals[idx] = val;
-        gc_add_reference((GCObject*)tbl, (GCObject*)val);
+        gc_release((GCObject*)old);
+        if (tbl->expiry)
+            expiry_update(tbl, (size_t)idx, ttl ? now + ttl : 0);
+        changelog_append(tbl, tbl->entries.keys[idx], val, tbl->expiry ? tbl->entries.expires[idx] : 0);
+        table_bump(tbl);
     } else {
         // 新增
         if (!ensure_capacity(tbl, tbl->entries.size + 1)) {
-            pthread_rwlock_unlock(&tbl->lock);
+            gc_mutate_end(gc);
+            table_unlock(tbl);
             return 0;  // 失败
         }
         tbl->entries.keys[tbl->entries.size] = key;
         tbl->entries.vals[tbl->entries.size] = val;
+        if (tbl->expiry) {
+            tbl->entries.expires[tbl->entries.size] = 0;
+            tbl->expiry->pos[tbl->entries.size] = HEAP_NONE;
+            expiry_update(tbl, tbl->entries.size, ttl ? now + ttl : 0);
+        }
         tbl->entries.size++;
-        gc_add_reference((GCObject*)tbl, (GCObject*)key);
-        gc_add_reference((GCObject*)tbl, (GCObject*)val);
+        gc_retain((GCObject*)key);
+        gc_retain((GCObject*)val);
+        changelog_append(tbl, key, val, tbl->expiry ? tbl->entries.expires[tbl->entries.size - 1] : 0);
+        table_bump(tbl);
+        if (stats_on(tbl) && tbl->entries.size > stat_get(&tbl->stats.peakSize))
+            atomic_store_explicit(&tbl->stats.peakSize, tbl->entries.size, memory_order_relaxed);   // 持有写锁，无竞争
     }
-    pthread_rwlock_unlock(&tbl->lock);
+    gc_mutate_end(gc);
+    table_unlock(tbl);
     return 1;  // 成功
 }
 
+int shared_table_set(SharedTable* tbl, StoredObject* key, StoredObject* val) {
+    return table_set(tbl, key, val, 0, 1);
+}
+
+int shared_table_set_ttl(SharedTable* tbl, StoredObject* key, StoredObject* val, double ttl) {
+    return table_set(tbl, key, val, ttl_to_ns(ttl), 0);
+}
+
+int shared_table_set_default_ttl(SharedTable* tbl, double ttl) {
+    uint64_t ns = ttl_to_ns(ttl);
+    table_wrlock(tbl);
+    if (!ns && !tbl->expiry) {   // 从未使用TTL，无需分配
+        table_unlock(tbl);
+        return 1;
+    }
+    if (!expiry_enable(tbl)) {
+        table_unlock(tbl);
+        return 0;
+    }
+    tbl->expiry->defaultTtl = ns;
+    table_bump(tbl);
+    table_unlock(tbl);
+    return 1;
+}
+
+double shared_table_get_default_ttl(SharedTable* tbl) {
+    table_rdlock(tbl);
+    double ttl = tbl->expiry ? tbl->expiry->defaultTtl / 1e9 : 0;
+    table_unlock(tbl);
+    return ttl;
+}
+
+size_t shared_table_expire(SharedTable* tbl, size_t max) {
+    GC* gc = tbl->header.gc;
+    table_wrlock(tbl);
+    size_t n = 0;
+    if (tbl->expiry) {
+        gc_mutate_begin(gc);
+        n = expire_some(tbl, mono_clock(), max);
+        gc_mutate_end(gc);
+    }
+    table_unlock(tbl);
+    return n;
+}
+
 StoredObject* shared_table_get(SharedTable* tbl, StoredObject* key) {
-    pthread_rwlock_rdlock(&tbl->lock);
+    table_rdlock(tbl);
+    TABLE_COUNT(tbl, reads);
     int idx = find_key_index(tbl, key);
-    StoredObject* result = (idx >= 0) ? tbl->entries.vals[idx] : NULL;
-    pthread_rwlock_unlock(&tbl->lock);
+    StoredObject* result = (idx >= 0 && entry_live(tbl, (size_t)idx, table_clock(tbl))) ? tbl->entries.vals[idx] : NULL;
+    if (result) {
+        // 解锁后其他线程可能删除它，所以返回前增加引用（在 gc_mutate_begin 内，与收集互斥）
+        gc_mutate_begin(tbl->header.gc);
+        gc_retain((GCObject*)result);
+        gc_mutate_end(tbl->header.gc);
+    }
+    table_unlock(tbl);
     return result;
 }
 
 void shared_table_delete(SharedTable* tbl, StoredObject* key) {
-    pthread_rwlock_wrlock(&tbl->lock);
+    GC* gc = tbl->header.gc;
+    table_wrlock(tbl);
+    TABLE_COUNT(tbl, deletes);
+    gc_mutate_begin(gc);
     int idx = find_key_index(tbl, key);
-    if (idx >= 0) {
-        // 释放键和值的引用
-        gc_release((GCObject*)tbl->entries.keys[idx]);
-        gc_release((GCObject*)tbl->entries.vals[idx]);
-        // 将最后一个元素移到当前位置
-        tbl->entries.keys[idx] = tbl->entries.keys[tbl->entries.size - 1];
-        tbl->entries.vals[idx] = tbl->entries.vals[tbl->entries.size - 1];
-        tbl->entries.size--;
-    }
-    pthread_rwlock_unlock(&tbl->lock);
+    if (idx >= 0)
+        remove_at(tbl, (size_t)idx);
+    expire_some(tbl, table_clock(tbl), EXPIRE_STEP);
+    gc_mutate_end(gc);
+    table_unlock(tbl);
 }
 
 size_t shared_table_size(SharedTable* tbl) {
-    pthread_rwlock_rdlock(&tbl->lock);
+    table_rdlock(tbl);
     size_t sz = tbl->entries.size;
-    pthread_rwlock_unlock(&tbl->lock);
+    if (tbl->expiry)
+        sz -= count_expired(tbl, 0, mono_clock());   // 不计已过期但尚未移除的条目
+    table_unlock(tbl);
     return sz;
 }
 
 size_t shared_table_length(SharedTable* tbl) {
-    pthread_rwlock_rdlock(&tbl->lock);
+    table_rdlock(tbl);
+    uint64_t now = table_clock(tbl);
     // 找出所有整数键
     size_t max = 0;
     for (size_t i = 0; i < tbl->entries.size; i++) {
         StoredObject* key = tbl->entries.keys[i];
-        if (key->type == STORED_INTEGER) {
+        if (key->type == STORED_INTEGER && entry_live(tbl, i, now)) {
             lua_Integer n = key->data.integer_val;
             if (n > 0) {
                 if ((size_t)n > max) max = (size_t)n;
@@ -136,53 +754,110 @@ size_t shared_table_length(SharedTable* tbl) {
         int found = 0;
         for (size_t j = 0; j < tbl->entries.size; j++) {
             if (stored_compare(tbl->entries.keys[j], &tmp) == 0) {
-                found = 1;
+                found = entry_live(tbl, j, now);
                 break;
             }
         }
         if (!found) break;
         len++;
     }
-    pthread_rwlock_unlock(&tbl->lock);
+    table_unlock(tbl);
     return len;
 }
 
 SharedTablePair shared_table_next(SharedTable* tbl, StoredObject* key) {
     SharedTablePair result = {NULL, NULL};
-    pthread_rwlock_rdlock(&tbl->lock);
+    table_rdlock(tbl);
+    TABLE_COUNT(tbl, reads);
     if (tbl->entries.size == 0) goto out;
 
-    if (key == NULL) {
-        // 从头开始
-        result.key = tbl->entries.keys[0];
-        result.val = tbl->entries.vals[0];
-    } else {
+    size_t i = 0;   // 从头开始
+    if (key != NULL) {
         // 找到key之后的下一个（假设key存在于表中，否则返回第一个？简化：线性查找）
         int start = find_key_index(tbl, key);
-        if (start >= 0 && start + 1 < (int)tbl->entries.size) {
-            result.key = tbl->entries.keys[start + 1];
-            result.val = tbl->entries.vals[start + 1];
-        }
+        if (start < 0) goto out;
+        i = (size_t)start + 1;
+    }
+    uint64_t now = table_clock(tbl);
+    while (i < tbl->entries.size && !entry_live(tbl, i, now))   // 跳过已过期的条目
+        i++;
+    if (i < tbl->entries.size) {
+        result.key = tbl->entries.keys[i];
+        result.val = tbl->entries.vals[i];
+        gc_mutate_begin(tbl->header.gc);
+        gc_retain((GCObject*)result.key);
+        gc_retain((GCObject*)result.val);
+        gc_mutate_end(tbl->header.gc);
     }
 out:
-    pthread_rwlock_unlock(&tbl->lock);
+    table_unlock(tbl);
     return result;
 }
 
+int shared_table_snapshot(SharedTable* tbl, SharedTablePair** out, size_t* count) {
+    SharedTablePair* pairs = NULL;
+    table_rdlock(tbl);
+    TABLE_COUNT(tbl, reads);
+    size_t n = tbl->entries.size;
+    if (n > 0) {
+        pairs = (SharedTablePair*)malloc(n * sizeof(SharedTablePair));
+        if (!pairs) {
+            table_unlock(tbl);
+            return 0;
+        }
+    }
+    uint64_t now = table_clock(tbl);
+    size_t live = 0;
+    gc_mutate_begin(tbl->header.gc);   // 与收集互斥地增加引用
+    for (size_t i = 0; i < n; i++) {
+        if (!entry_live(tbl, i, now)) continue;
+        pairs[live].key = tbl->entries.keys[i];
+        pairs[live].val = tbl->entries.vals[i];
+        gc_retain((GCObject*)pairs[live].key);
+        gc_retain((GCObject*)pairs[live].val);
+        live++;
+    }
+    gc_mutate_end(tbl->header.gc);
+    n = live;
+    table_unlock(tbl);
+    *out = pairs;
+    *count = n;
+    return 1;
+}
+
+void shared_table_snapshot_free(SharedTablePair* pairs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        gc_release((GCObject*)pairs[i].key);
+        gc_release((GCObject*)pairs[i].val);
+    }
+    free(pairs);
+}
+
 void shared_table_set_metatable(SharedTable* tbl, StoredObject* mt) {
-    pthread_rwlock_wrlock(&tbl->lock);
-    if (tbl->metatable)
-        gc_release((GCObject*)tbl->metatable);
-    tbl->metatable = mt;
+    GC* gc = tbl->header.gc;
+    table_wrlock(tbl);
+    TABLE_COUNT(tbl, writes);
+    gc_mutate_begin(gc);
+    StoredObject* old = tbl->metatable;
     if (mt)
-        gc_add_reference((GCObject*)tbl, (GCObject*)mt);
-    pthread_rwlock_unlock(&tbl->lock);
+        gc_retain((GCObject*)mt);
+    tbl->metatable = mt;
+    if (old)
+        gc_release((GCObject*)old);
+    table_bump(tbl);
+    gc_mutate_end(gc);
+    table_unlock(tbl);
 }
 
 StoredObject* shared_table_get_metatable(SharedTable* tbl) {
-    pthread_rwlock_rdlock(&tbl->lock);
+    table_rdlock(tbl);
     StoredObject* mt = tbl->metatable;
-    pthread_rwlock_unlock(&tbl->lock);
+    if (mt) {
+        gc_mutate_begin(tbl->header.gc);
+        gc_retain((GCObject*)mt);
+        gc_mutate_end(tbl->header.gc);
+    }
+    table_unlock(tbl);
     return mt;
 }
 
@@ -191,23 +866,49 @@ StoredObject* shared_table_get_metatable(SharedTable* tbl) {
 const char* SHARED_TABLE_MT = "XShare.table";
 
 // 辅助：从栈上获取SharedTable*（userdata）
+// shared_table_tx_join 失败时抛出错误（事务的锁由 transaction 释放）
+static int tx_error(lua_State* L, SharedTable* tbl, int r) {
+    if (r < 0) return luaL_error(L, "out of memory");
+    return luaL_error(L, "timed out after %f s waiting for table %p inside a transaction "
+                      "(another thread holds it, possibly a deadlock), add it to the transaction list",
+                      shared_table_get_tx_timeout(), (void*)tbl);
+}
+
+// 事务中访问列表之外的表时先把它加入事务
+static SharedTable* tx_check(lua_State* L, SharedTable* tbl) {
+    if (!tls_tx_root) return tbl;
+    int r = shared_table_tx_join(tbl);
+    if (r <= 0) tx_error(L, tbl, r);
+    return tbl;
+}
+
 SharedTable* check_shared_table(lua_State* L, int idx) {
     void* ud = luaL_checkudata(L, idx, SHARED_TABLE_MT);
     luaL_argcheck(L, ud != NULL, idx, "xshare.table expected");
-    return *(SharedTable**)ud;
+    return tx_check(L, *(SharedTable**)ud);
 }
 
-// 构造函数：xshare.table([tbl]) -> userdata
+// 绑定函数所在的堆：xshare.heap() 创建的闭包以第一个 upvalue 保存堆句柄（持有 GC* 的 userdata），
+// 默认堆的 gc 表以轻量 userdata 保存堆指针，没有 upvalue 时为默认堆
+GC* shared_table_upvalue_heap(lua_State* L) {
+    void* p = lua_touserdata(L, lua_upvalueindex(1));
+    if (!p) return gc_instance();
+    if (lua_type(L, lua_upvalueindex(1)) == LUA_TUSERDATA)
+        return *(GC**)p;
+    return (GC*)p;
+}
+
+// 构造函数：xshare.table([tbl]) / heap.table([tbl]) -> userdata
 int l_shared_table_new(lua_State* L) {
-    GC* gc = gc_instance();
+    GC* gc = shared_table_upvalue_heap(L);
     SharedTable* st = shared_table_create(gc);
     if (!st) return luaL_error(L, "cannot create shared table");
 
     // 创建userdata，存储指针
     SharedTable** ud = (SharedTable**)lua_newuserdata(L, sizeof(SharedTable*));
     *ud = st;
-    luaL_setmetatable(L, SHARED_TABLE_MT);
-    gc_retain((GCObject*)st);   // 增加引用
+    luaL_setmetatable(L, SHARED_TABLE_MT);   // 创建时持有的引用转交给userdata
+    stored_remember_object(L, -1);
 
     // 如果提供了初始化表，则复制内容
     if (lua_gettop(L) >= 1 && !lua_isnil(L, 1)) {
@@ -217,8 +918,8 @@ int l_shared_table_new(lua_State* L) {
         lua_pushnil(L);
         while (lua_next(L, 1)) {
             // 键在-2，值在-1
-            StoredObject* key = stored_create(L, -2);
-            StoredObject* val = stored_create(L, -1);
+            StoredObject* key = stored_create_ex(L, -2, gc);
+            StoredObject* val = stored_create_ex(L, -1, gc);
             if (!key || !val) {
                 // 清理
                 if (key) gc_release((GCObject*)key);
@@ -241,51 +942,75 @@ int l_shared_table_new(lua_State* L) {
 // __index 元方法
 int l_shared_table_index(lua_State* L) {
     SharedTable* tbl = check_shared_table(L, 1);
-    StoredObject* key = stored_create(L, 2);
+    StoredObject* key = stored_create_ex(L, 2, tbl->header.gc);
     if (!key) return luaL_error(L, "invalid key");
 
     StoredObject* val = shared_table_get(tbl, key);
     gc_release((GCObject*)key);
 
     if (val) {
+        TABLE_COUNT(tbl, hits);
         stored_push(L, val);
+        gc_release((GCObject*)val);
         return 1;
     }
+    TABLE_COUNT(tbl, misses);   // 未命中，回退到元表的 __index
 
     // 检查元表的__index
     StoredObject* mt = shared_table_get_metatable(tbl);
+    StoredObject* index_val = NULL;
     if (mt && mt->type == STORED_SHARED_TABLE) {
         SharedTable* mttbl = mt->data.shared_table;
+        int r = shared_table_tx_join(mttbl);
+        if (r <= 0) {
+            gc_release((GCObject*)mt);
+            return tx_error(L, mttbl, r);
+        }
 
         // 创建 "__index" 键
         lua_pushstring(L, "__index");
-        StoredObject* index_key = stored_create(L, -1);
+        StoredObject* index_key = stored_create_ex(L, -1, mttbl->header.gc);
         lua_pop(L, 1);
-        if (!index_key) return luaL_error(L, "out of memory");
-
-        StoredObject* index_val = shared_table_get(mttbl, index_key);
-        gc_release((GCObject*)index_key);
-
-        if (index_val) {
-            if (index_val->type == STORED_FUNCTION) {
-                // 调用函数
-                stored_push(L, index_val);
-                lua_pushvalue(L, 1); // self
-                lua_pushvalue(L, 2); // key
-                lua_call(L, 2, LUA_MULTRET);
-                return lua_gettop(L) - 2; // 减去栈上的 self, key, func
-            } else if (index_val->type == STORED_SHARED_TABLE) {
-                // 如果是表，则在该表中查找原始键
-                SharedTable* index_tbl = index_val->data.shared_table;
-                StoredObject* mtkey = stored_create(L, 2);
-                if (!mtkey) return luaL_error(L, "invalid key for metatable");
-                StoredObject* mtval = shared_table_get(index_tbl, mtkey);
+        if (index_key) {
+            index_val = shared_table_get(mttbl, index_key);
+            gc_release((GCObject*)index_key);
+        }
+    }
+    if (mt)
+        gc_release((GCObject*)mt);
+
+    if (index_val) {
+        if (index_val->type == STORED_FUNCTION) {
+            // 调用函数
+            stored_push(L, index_val);
+            gc_release((GCObject*)index_val);
+            lua_pushvalue(L, 1); // self
+            lua_pushvalue(L, 2); // key
+            lua_call(L, 2, LUA_MULTRET);
+            return lua_gettop(L) - 2; // 减去栈上的 self, key, func
+        } else if (index_val->type == STORED_SHARED_TABLE) {
+            // 如果是表，则在该表中查找原始键
+            SharedTable* index_tbl = index_val->data.shared_table;
+            int r = shared_table_tx_join(index_tbl);
+            if (r <= 0) {
+                gc_release((GCObject*)index_val);
+                return tx_error(L, index_tbl, r);
+            }
+            StoredObject* mtkey = stored_create_ex(L, 2, index_tbl->header.gc);
+            StoredObject* mtval = NULL;
+            if (mtkey) {
+                mtval = shared_table_get(index_tbl, mtkey);
                 gc_release((GCObject*)mtkey);
-                if (mtval) {
-                    stored_push(L, mtval);
-                    return 1;
-                }
             }
+            gc_release((GCObject*)index_val);
+            if (!mtkey) return luaL_error(L, "invalid key for metatable");
+            if (mtval) {
+                stored_push(L, mtval);
+                gc_release((GCObject*)mtval);
+                return 1;
+            }
+        } else {
+            gc_release((GCObject*)index_val);
         }
     }
     lua_pushnil(L);
@@ -295,8 +1020,8 @@ int l_shared_table_index(lua_State* L) {
 // __newindex 元方法
 int l_shared_table_newindex(lua_State* L) {
     SharedTable* tbl = check_shared_table(L, 1);
-    StoredObject* key = stored_create(L, 2);
-    StoredObject* val = stored_create(L, 3);
+    StoredObject* key = stored_create_ex(L, 2, tbl->header.gc);
+    StoredObject* val = stored_create_ex(L, 3, tbl->header.gc);
     if (!key || !val) {
         if (key) gc_release((GCObject*)key);
         if (val) gc_release((GCObject*)val);
@@ -305,50 +1030,71 @@ int l_shared_table_newindex(lua_State* L) {
 
     // 检查元表的__newindex
     StoredObject* mt = shared_table_get_metatable(tbl);
+    StoredObject* newindex_val = NULL;
+    int oom = 0;
     if (mt && mt->type == STORED_SHARED_TABLE) {
         SharedTable* mttbl = mt->data.shared_table;
+        int r = shared_table_tx_join(mttbl);
+        if (r <= 0) {
+            gc_release((GCObject*)mt);
+            gc_release((GCObject*)key);
+            gc_release((GCObject*)val);
+            return tx_error(L, mttbl, r);
+        }
 
         // 创建 "__newindex" 键
         lua_pushstring(L, "__newindex");
-        StoredObject* newindex_key = stored_create(L, -1);
+        StoredObject* newindex_key = stored_create_ex(L, -1, mttbl->header.gc);
         lua_pop(L, 1);
-        if (!newindex_key) {
-            gc_release((GCObject*)key);
-            gc_release((GCObject*)val);
-            return luaL_error(L, "out of memory");
+        if (newindex_key) {
+            newindex_val = shared_table_get(mttbl, newindex_key);
+            gc_release((GCObject*)newindex_key);
+        } else {
+            oom = 1;
         }
+    }
+    if (mt)
+        gc_release((GCObject*)mt);
+    if (oom) {
+        gc_release((GCObject*)key);
+        gc_release((GCObject*)val);
+        return luaL_error(L, "out of memory");
+    }
 
-        StoredObject* newindex_val = shared_table_get(mttbl, newindex_key);
-        gc_release((GCObject*)newindex_key);
-
-        if (newindex_val) {
-            if (newindex_val->type == STORED_FUNCTION) {
-                // 调用函数
-                stored_push(L, newindex_val);
-                lua_pushvalue(L, 1); // self
-                lua_pushvalue(L, 2); // key
-                lua_pushvalue(L, 3); // value
-                lua_call(L, 3, 0);
-                gc_release((GCObject*)key);
-                gc_release((GCObject*)val);
-                return 0;
-            } else if (newindex_val->type == STORED_SHARED_TABLE) {
-                // 如果是表，则在该表中进行赋值
-                SharedTable* index_tbl = newindex_val->data.shared_table;
-                if (val->type == STORED_NIL) {
-                    shared_table_delete(index_tbl, key);
-                } else {
-                    if (!shared_table_set(index_tbl, key, val)) {
-                        gc_release((GCObject*)key);
-                        gc_release((GCObject*)val);
-                        return luaL_error(L, "failed to set table entry (out of memory)");
-                    }
-                }
+    if (newindex_val) {
+        if (newindex_val->type == STORED_FUNCTION) {
+            // 调用函数
+            gc_release((GCObject*)key);
+            gc_release((GCObject*)val);
+            stored_push(L, newindex_val);
+            gc_release((GCObject*)newindex_val);
+            lua_pushvalue(L, 1); // self
+            lua_pushvalue(L, 2); // key
+            lua_pushvalue(L, 3); // value
+            lua_call(L, 3, 0);
+            return 0;
+        } else if (newindex_val->type == STORED_SHARED_TABLE) {
+            // 如果是表，则在该表中进行赋值
+            SharedTable* index_tbl = newindex_val->data.shared_table;
+            int r = shared_table_tx_join(index_tbl);
+            if (r <= 0) {
+                gc_release((GCObject*)newindex_val);
                 gc_release((GCObject*)key);
                 gc_release((GCObject*)val);
-                return 0;
+                return tx_error(L, index_tbl, r);
             }
+            int ok = 1;
+            if (val->type == STORED_NIL)
+                shared_table_delete(index_tbl, key);
+            else
+                ok = shared_table_set(index_tbl, key, val);
+            gc_release((GCObject*)newindex_val);
+            gc_release((GCObject*)key);
+            gc_release((GCObject*)val);
+            if (!ok) return luaL_error(L, "failed to set table entry (out of memory)");
+            return 0;
         }
+        gc_release((GCObject*)newindex_val);
     }
 
     // 没有元方法或元方法不处理，执行默认赋值
@@ -379,7 +1125,7 @@ int l_shared_table_next(lua_State* L) {
     SharedTable* tbl = check_shared_table(L, 1);
     StoredObject* key = NULL;
     if (!lua_isnil(L, 2)) {
-        key = stored_create(L, 2);
+        key = stored_create_ex(L, 2, tbl->header.gc);
         if (!key) return luaL_error(L, "invalid key");
     }
     SharedTablePair pair = shared_table_next(tbl, key);
@@ -387,6 +1133,8 @@ int l_shared_table_next(lua_State* L) {
     if (pair.key) {
         stored_push(L, pair.key);
         stored_push(L, pair.val);
+        gc_release((GCObject*)pair.key);
+        gc_release((GCObject*)pair.val);
         return 2;
     } else {
         return 0;
@@ -413,6 +1161,7 @@ int l_shared_table_ipairs_next(lua_State* L) {
     if (val) {
         lua_pushinteger(L, i);
         stored_push(L, val);
+        gc_release((GCObject*)val);
         return 2;
     } else {
         return 0;
@@ -442,15 +1191,15 @@ int l_shared_table_setmetatable(lua_State* L) {
     if (!lua_isnil(L, 2)) {
         // 如果第二个参数是普通表，先转换为SharedTable
         if (lua_istable(L, 2)) {
-            // 创建新的SharedTable并从表复制内容
-            GC* gc = gc_instance();
+            // 创建新的SharedTable并从表复制内容（与目标表同堆）
+            GC* gc = tbl->header.gc;
             SharedTable* mtbl = shared_table_create(gc);
             if (!mtbl) return luaL_error(L, "cannot create metatable");
             // 遍历并复制...
             lua_pushnil(L);
             while (lua_next(L, 2)) {
-                StoredObject* k = stored_create(L, -2);
-                StoredObject* v = stored_create(L, -1);
+                StoredObject* k = stored_create_ex(L, -2, gc);
+                StoredObject* v = stored_create_ex(L, -1, gc);
                 if (k && v) {
                     if (!shared_table_set(mtbl, k, v)) {
                         gc_release((GCObject*)k);
@@ -465,12 +1214,12 @@ int l_shared_table_setmetatable(lua_State* L) {
                 }
                 lua_pop(L, 1);
             }
-            mt = stored_create_from_sharedtable(mtbl);
+            mt = stored_create_from_sharedtable_ex(mtbl, gc);
             gc_release((GCObject*)mtbl); // 释放临时引用，mt持有新引用
         } else {
             // 假设已经是xshare.table userdata
             SharedTable* mtbl = check_shared_table(L, 2);
-            mt = stored_create_from_sharedtable(mtbl);
+            mt = stored_create_from_sharedtable_ex(mtbl, tbl->header.gc);
         }
     }
     shared_table_set_metatable(tbl, mt);
@@ -483,22 +1232,20 @@ int l_shared_table_setmetatable(lua_State* L) {
 int l_shared_table_getmetatable(lua_State* L) {
     SharedTable* tbl = check_shared_table(L, 1);
     StoredObject* mt = shared_table_get_metatable(tbl);
-    if (mt && mt->type == STORED_SHARED_TABLE) {
-        SharedTable** ud = (SharedTable**)lua_newuserdata(L, sizeof(SharedTable*));
-        *ud = mt->data.shared_table;
-        luaL_setmetatable(L, SHARED_TABLE_MT);
-        gc_retain((GCObject*)mt->data.shared_table);   // 增加引用
-        return 1;
-    }
-    lua_pushnil(L);
+    if (mt && mt->type == STORED_SHARED_TABLE)
+        stored_push_object(L, (GCObject*)mt->data.shared_table, SHARED_TABLE_MT);
+    else
+        lua_pushnil(L);
+    if (mt)
+        gc_release((GCObject*)mt);
     return 1;
 }
 
 // xshare.rawset(tbl, key, value)
 int l_shared_table_rawset(lua_State* L) {
     SharedTable* tbl = check_shared_table(L, 1);
-    StoredObject* key = stored_create(L, 2);
-    StoredObject* val = stored_create(L, 3);
+    StoredObject* key = stored_create_ex(L, 2, tbl->header.gc);
+    StoredObject* val = stored_create_ex(L, 3, tbl->header.gc);
     if (!key || !val) {
         if (key) gc_release((GCObject*)key);
         if (val) gc_release((GCObject*)val);
@@ -522,12 +1269,13 @@ int l_shared_table_rawset(lua_State* L) {
 // xshare.rawget(tbl, key)
 int l_shared_table_rawget(lua_State* L) {
     SharedTable* tbl = check_shared_table(L, 1);
-    StoredObject* key = stored_create(L, 2);
+    StoredObject* key = stored_create_ex(L, 2, tbl->header.gc);
     if (!key) return luaL_error(L, "invalid key");
     StoredObject* val = shared_table_get(tbl, key);
     gc_release((GCObject*)key);
     if (val) {
         stored_push(L, val);
+        gc_release((GCObject*)val);
     } else {
         lua_pushnil(L);
     }
@@ -549,4 +1297,427 @@ int l_shared_table_gc(lua_State* L) {
         *ud = NULL;
     }
     return 0;
-}
\ No newline at end of file
+}
+
+// xshare.stats(t) -> 统计表
+// xshare.stats(t, enable) 为单个表开关统计；xshare.stats(enable) 为所有表开关统计
+int l_shared_table_stats(lua_State* L) {
+    if (lua_isboolean(L, 1)) {
+        shared_table_enable_stats(NULL, lua_toboolean(L, 1));
+        return 0;
+    }
+    SharedTable* tbl = check_shared_table(L, 1);
+    if (!lua_isnoneornil(L, 2)) {
+        shared_table_enable_stats(tbl, lua_toboolean(L, 2));
+        return 0;
+    }
+    SharedTableStats st;
+    shared_table_get_stats(tbl, &st);
+    lua_newtable(L);
+    lua_pushboolean(L, st.enabled);        lua_setfield(L, -2, "enabled");
+    lua_pushinteger(L, st.reads);          lua_setfield(L, -2, "reads");
+    lua_pushinteger(L, st.writes);         lua_setfield(L, -2, "writes");
+    lua_pushinteger(L, st.deletes);        lua_setfield(L, -2, "deletes");
+    lua_pushinteger(L, st.readWaits);      lua_setfield(L, -2, "read_waits");
+    lua_pushinteger(L, st.writeWaits);     lua_setfield(L, -2, "write_waits");
+    lua_pushnumber(L, st.readWaitTime);    lua_setfield(L, -2, "read_wait_time");
+    lua_pushnumber(L, st.writeWaitTime);   lua_setfield(L, -2, "write_wait_time");
+    lua_pushinteger(L, st.hits);           lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, st.misses);         lua_setfield(L, -2, "misses");
+    size_t lookups = st.hits + st.misses;
+    lua_pushnumber(L, lookups ? (double)st.hits / lookups : 0);
+    lua_setfield(L, -2, "hit_ratio");
+    lua_pushinteger(L, st.size);           lua_setfield(L, -2, "size");
+    lua_pushinteger(L, st.peakSize);       lua_setfield(L, -2, "peak_size");
+    lua_pushinteger(L, st.resizes);        lua_setfield(L, -2, "resizes");
+    return 1;
+}
+
+// xshare.transaction({t1, t2, ...}, fn, ...) -> fn 的返回值
+// 持有所有表的写锁调用 fn(...)，fn 出错时先释放锁再重新抛出错误
+int l_shared_table_transaction(lua_State* L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    int nargs = lua_gettop(L) - 2;
+    size_t n = (size_t)lua_rawlen(L, 1);
+    SharedTable** tables = (SharedTable**)lua_newuserdata(L, (n ? n : 1) * sizeof(SharedTable*));
+    for (size_t i = 0; i < n; i++) {
+        lua_rawgeti(L, 1, (lua_Integer)i + 1);
+        SharedTable** ud = (SharedTable**)luaL_testudata(L, -1, SHARED_TABLE_MT);
+        if (!ud || !*ud) return luaL_argerror(L, 1, "shared tables expected");
+        tables[i] = *ud;
+        lua_pop(L, 1);
+    }
+    int base = lua_gettop(L);
+    lua_pushvalue(L, 2);
+    for (int i = 0; i < nargs; i++)
+        lua_pushvalue(L, 3 + i);
+
+    SharedTableTx tx;
+    if (!shared_table_tx_begin(&tx, tables, n))
+        return luaL_error(L, "nested transaction can only use tables of the enclosing transaction");
+    for (size_t i = 0; i < tx.count; i++)
+        gc_retain((GCObject*)tables[i]);   // fn 可能丢掉列表中的表
+    int status = lua_pcall(L, nargs, LUA_MULTRET, 0);
+    shared_table_tx_end(&tx);
+    for (size_t i = 0; i < tx.count; i++)
+        gc_release((GCObject*)tables[i]);
+    if (status != LUA_OK) return lua_error(L);
+    return lua_gettop(L) - base;
+}
+
+// xshare.changelog(t, capacity) -> 当前序号
+// 为 t 启用最多保留 capacity 条的变更日志，capacity 为0时关闭
+int l_shared_table_changelog(lua_State* L) {
+    SharedTable* tbl = check_shared_table(L, 1);
+    lua_Integer cap = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, cap >= 0, 2, "capacity must be non-negative");
+    if (!shared_table_enable_changes(tbl, (size_t)cap))
+        return luaL_error(L, "cannot allocate change log");
+    table_rdlock(tbl);
+    size_t last = tbl->changeSeq;
+    table_unlock(tbl);
+    lua_pushinteger(L, (lua_Integer)last);
+    return 1;
+}
+
+#define CHANGES_BATCH 64
+
+// xshare.changes(t[, since]) -> seq, { {key, value}, ... }
+// 返回序号 since（默认0）之后的变更，value 为这次写入的值（删除或已过期为nil）；
+// 日志未启用或已覆盖这些变更时返回 seq, nil，调用者需要用 pairs 完整同步
+int l_shared_table_changes(lua_State* L) {
+    SharedTable* tbl = check_shared_table(L, 1);
+    lua_Integer since = luaL_optinteger(L, 2, 0);
+    luaL_argcheck(L, since >= 0, 2, "sequence number must be non-negative");
+    SharedTableChange buf[CHANGES_BATCH];
+    size_t from = (size_t)since, last = 0;
+    lua_Integer count = 0;
+    lua_newtable(L);
+    for (;;) {
+        long n = shared_table_changes(tbl, from, buf, CHANGES_BATCH, &last);
+        if (n < 0) {
+            lua_pushinteger(L, (lua_Integer)last);
+            lua_pushnil(L);
+            return 2;
+        }
+        for (long i = 0; i < n; i++) {
+            lua_createtable(L, 2, 0);
+            stored_push(L, buf[i].key);
+            lua_rawseti(L, -2, 1);
+            gc_release((GCObject*)buf[i].key);
+            if (buf[i].val) {
+                stored_push(L, buf[i].val);
+                lua_rawseti(L, -2, 2);
+                gc_release((GCObject*)buf[i].val);
+            }
+            lua_rawseti(L, -2, ++count);
+        }
+        if (n < CHANGES_BATCH) break;
+        from = buf[n - 1].seq;
+    }
+    lua_pushinteger(L, (lua_Integer)last);
+    lua_insert(L, -2);
+    return 2;
+}
+
+// ---------- 本地读缓存 ----------
+
+// 注册表中 SharedTable* -> 缓存代理 的弱值表
+static const char* CACHED_REGISTRY = "XShare.cached";
+static char cached_nil;   // 缓存“键不存在”的哨兵（轻量 userdata）
+
+#define CACHED_TABLE lua_upvalueindex(1)     // 共享表 userdata
+#define CACHED_VALUES lua_upvalueindex(2)    // 本地缓存表
+#define CACHED_VERSION lua_upvalueindex(3)   // 缓存对应的版本号
+
+/* 内部：在共享表本身中查找栈上 idx 处的键并压入结果。找到返回1；找到但每次读取都生成新的可变
+ * Lua 对象（表副本、Lua 函数）返回2（不缓存，否则各次读取会共享并修改同一个副本）；
+ * 不存在且表没有元表返回0（可以缓存nil）；不存在但有元表返回-1（结果取决于元表，不缓存） */
+static int cached_lookup(lua_State* L, SharedTable* tbl, int idx) {
+    StoredObject tmp;
+    StoredObject* key = stored_lookup_key(L, idx, &tmp, tbl->header.gc);
+    if (!key) return luaL_error(L, "invalid key");
+    StoredObject* val = shared_table_get(tbl, key);
+    if (key != &tmp) gc_release((GCObject*)key);
+    if (val) {
+        TABLE_COUNT(tbl, hits);
+        int fresh = val->type == STORED_TABLE_COPY || val->type == STORED_FUNCTION;
+        stored_push(L, val);
+        gc_release((GCObject*)val);
+        return fresh ? 2 : 1;
+    }
+    StoredObject* mt = shared_table_get_metatable(tbl);
+    if (!mt) return 0;
+    gc_release((GCObject*)mt);
+    return -1;
+}
+
+// 代理的 __index：版本号未变时直接读本地缓存表
+static int cached_index(lua_State* L) {
+    SharedTable* tbl = tx_check(L, *(SharedTable**)lua_touserdata(L, CACHED_TABLE));
+    lua_Integer version = (lua_Integer)shared_table_version(tbl);
+    if (lua_tointeger(L, CACHED_VERSION) != version) {
+        // 表已被修改：丢弃整个缓存（先读版本号再读值，读到的值不会比版本号旧）
+        lua_newtable(L);
+        lua_replace(L, CACHED_VALUES);
+        lua_pushinteger(L, version);
+        lua_replace(L, CACHED_VERSION);
+    } else {
+        lua_pushvalue(L, 2);
+        if (lua_rawget(L, CACHED_VALUES) != LUA_TNIL) {
+            if (lua_touserdata(L, -1) == &cached_nil) lua_pushnil(L);
+            return 1;
+        }
+        lua_pop(L, 1);
+    }
+    if (lua_isnil(L, 2)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    table_rdlock(tbl);
+    int ttl = tbl->expiry != NULL;
+    table_unlock(tbl);
+    // 启用了TTL的表中条目会随时间过期而不改变版本号，同样不缓存
+    int found = ttl ? -1 : cached_lookup(L, tbl, 2);
+    if (found < 0) {
+        // 结果取决于元表（可能来自其他表或函数），按普通方式读取，不缓存
+        TABLE_COUNT(tbl, misses);
+        lua_pushvalue(L, CACHED_TABLE);
+        lua_pushvalue(L, 2);
+        lua_gettable(L, -2);
+        return 1;
+    }
+    if (found == 2) return 1;
+    if (!found) lua_pushlightuserdata(L, &cached_nil);
+    lua_pushvalue(L, 2);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, CACHED_VALUES);
+    if (!found) lua_pushnil(L);
+    return 1;
+}
+
+// 代理的 __newindex、__len、__pairs 直接转给共享表
+static int cached_newindex(lua_State* L) {
+    lua_pushvalue(L, CACHED_TABLE);
+    lua_pushvalue(L, 2);
+    lua_pushvalue(L, 3);
+    lua_settable(L, -3);
+    return 0;
+}
+
+static int cached_len(lua_State* L) {
+    SharedTable* tbl = tx_check(L, *(SharedTable**)lua_touserdata(L, CACHED_TABLE));
+    lua_pushinteger(L, (lua_Integer)shared_table_length(tbl));
+    return 1;
+}
+
+static int cached_pairs(lua_State* L) {
+    lua_pushcfunction(L, l_shared_table_next);
+    lua_pushvalue(L, CACHED_TABLE);
+    lua_pushnil(L);
+    return 3;
+}
+
+// xshare.cached(t) -> 代理
+// 返回 t 在当前 lua_State 中的读缓存代理（同一个表返回同一个代理）。读取先比较版本号，
+// 未变时直接查本地 Lua 表；表被修改后整个缓存失效。写入、# 和 pairs 直接作用于 t
+int l_shared_table_cached(lua_State* L) {
+    SharedTable* tbl = check_shared_table(L, 1);
+    lua_settop(L, 1);
+    if (lua_getfield(L, LUA_REGISTRYINDEX, CACHED_REGISTRY) == LUA_TNIL) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_createtable(L, 0, 1);
+        lua_pushliteral(L, "v");
+        lua_setfield(L, -2, "__mode");
+        lua_setmetatable(L, -2);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, CACHED_REGISTRY);
+    }
+    // 代理持有表的引用，代理存在期间表的地址不会被复用
+    if (lua_rawgetp(L, 2, tbl) != LUA_TNIL) return 1;
+    lua_pop(L, 1);
+
+    lua_newtable(L);                       // 代理（始终为空表，读写都经过元表）
+    lua_createtable(L, 0, 5);              // 代理的元表
+    lua_pushvalue(L, 1);
+    lua_newtable(L);
+    lua_pushinteger(L, -1);                // 首次读取时初始化
+    lua_pushcclosure(L, cached_index, 3);
+    lua_setfield(L, -2, "__index");
+    static const luaL_Reg mt[] = {
+        {"__newindex", cached_newindex},
+        {"__len", cached_len},
+        {"__pairs", cached_pairs},
+        {NULL, NULL}
+    };
+    lua_pushvalue(L, 1);
+    luaL_setfuncs(L, mt, 1);
+    lua_pushliteral(L, "xshare.cached");
+    lua_setfield(L, -2, "__name");
+    lua_setmetatable(L, -2);
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, 2, tbl);
+    return 1;
+}
+
+// ---------- 批量读取 ----------
+
+// 快照放在带 __gc 的 userdata 中，Lua 出错（例如 foreach 的回调出错）时也能释放引用
+typedef struct TableSnapshot {
+    SharedTablePair* pairs;
+    size_t count;
+} TableSnapshot;
+
+static const char* SNAPSHOT_MT = "XShare.snapshot";
+
+// 释放快照持有的引用（可以提前调用，__gc 时不再重复释放）
+static void snapshot_release(TableSnapshot* snap) {
+    shared_table_snapshot_free(snap->pairs, snap->count);
+    snap->pairs = NULL;
+    snap->count = 0;
+}
+
+static int snapshot_gc(lua_State* L) {
+    snapshot_release((TableSnapshot*)lua_touserdata(L, 1));
+    return 0;
+}
+
+// 压入 tbl 的快照 userdata（事务中先把 tbl 加入事务，deep 转换的子表也经过这里）
+static TableSnapshot* push_snapshot(lua_State* L, SharedTable* tbl) {
+    tx_check(L, tbl);
+    TableSnapshot* snap = (TableSnapshot*)lua_newuserdata(L, sizeof(TableSnapshot));
+    snap->pairs = NULL;
+    snap->count = 0;
+    if (luaL_newmetatable(L, SNAPSHOT_MT)) {
+        lua_pushcfunction(L, snapshot_gc);
+        lua_setfield(L, -2, "__gc");
+    }
+    lua_setmetatable(L, -2);
+    if (!shared_table_snapshot(tbl, &snap->pairs, &snap->count))
+        luaL_error(L, "out of memory");
+    return snap;
+}
+
+/* 内部：把 tbl 转为 Lua 表压入栈。deep 时值中的共享表也递归转换，
+ * seen（栈上的表，SharedTable* -> 结果）保证共享的子表和环只转换一次 */
+static void push_plain_table(lua_State* L, SharedTable* tbl, int deep, int seen) {
+    luaL_checkstack(L, 8, "shared table nested too deeply");
+    TableSnapshot* snap = push_snapshot(L, tbl);
+    int snapIdx = lua_gettop(L);
+    // 数组部分：1..count 范围内的整数键
+    size_t narr = 0;
+    for (size_t i = 0; i < snap->count; i++) {
+        StoredObject* k = snap->pairs[i].key;
+        if (k->type == STORED_INTEGER && k->data.integer_val >= 1 &&
+            (lua_Unsigned)k->data.integer_val <= snap->count)
+            narr++;
+    }
+    lua_createtable(L, (int)narr, (int)(snap->count - narr));
+    if (deep) {
+        lua_pushvalue(L, -1);
+        lua_rawsetp(L, seen, tbl);
+    }
+    for (size_t i = 0; i < snap->count; i++) {
+        stored_push(L, snap->pairs[i].key);
+        StoredObject* v = snap->pairs[i].val;
+        if (deep && v->type == STORED_SHARED_TABLE) {
+            if (lua_rawgetp(L, seen, v->data.shared_table) == LUA_TNIL) {
+                lua_pop(L, 1);
+                push_plain_table(L, v->data.shared_table, deep, seen);
+            }
+        } else {
+            stored_push(L, v);
+        }
+        lua_rawset(L, -3);
+    }
+    snapshot_release(snap);
+    lua_remove(L, snapIdx);
+}
+
+// xshare.totable(t[, deep]) -> Lua 表
+// 一次加锁取得全部键值对并转为普通 Lua 表；deep 时值中的共享表也递归转换
+int l_shared_table_totable(lua_State* L) {
+    SharedTable* tbl = check_shared_table(L, 1);
+    int deep = lua_toboolean(L, 2);
+    lua_settop(L, 1);
+    int seen = 0;
+    if (deep) {
+        lua_newtable(L);
+        seen = lua_gettop(L);
+    }
+    push_plain_table(L, tbl, deep, seen);
+    return 1;
+}
+
+// xshare.foreach(t, fn)
+// 对一次加锁取得的快照逐个调用 fn(key, value)，fn 返回 false 时停止。
+// 调用 fn 时不持有表锁，fn 可以修改 t（不影响本次遍历）
+int l_shared_table_foreach(lua_State* L) {
+    SharedTable* tbl = check_shared_table(L, 1);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    lua_settop(L, 2);
+    TableSnapshot* snap = push_snapshot(L, tbl);
+    for (size_t i = 0; i < snap->count; i++) {
+        lua_pushvalue(L, 2);
+        stored_push(L, snap->pairs[i].key);
+        stored_push(L, snap->pairs[i].val);
+        lua_call(L, 2, 1);
+        int stop = lua_isboolean(L, -1) && !lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        if (stop) break;
+    }
+    snapshot_release(snap);
+    return 0;
+}
+
+// ---------- 过期 ----------
+
+// xshare.setex(t, key, value, ttl) -> t
+// 设置键值对，ttl 秒后过期（ttl <= 0 为不过期）；value 为 nil 时删除
+int l_shared_table_setex(lua_State* L) {
+    SharedTable* tbl = check_shared_table(L, 1);
+    lua_Number ttl = luaL_checknumber(L, 4);
+    StoredObject* key = stored_create_ex(L, 2, tbl->header.gc);
+    StoredObject* val = stored_create_ex(L, 3, tbl->header.gc);
+    if (!key || !val) {
+        if (key) gc_release((GCObject*)key);
+        if (val) gc_release((GCObject*)val);
+        return luaL_error(L, "invalid key or value");
+    }
+    int ok = 1;
+    if (val->type == STORED_NIL)
+        shared_table_delete(tbl, key);
+    else
+        ok = shared_table_set_ttl(tbl, key, val, (double)ttl);
+    gc_release((GCObject*)key);
+    gc_release((GCObject*)val);
+    if (!ok) return luaL_error(L, "failed to set table entry (out of memory)");
+    lua_pushvalue(L, 1);
+    return 1;
+}
+
+// xshare.default_ttl(t[, ttl]) -> 当前的默认TTL（秒）
+// 给出 ttl 时设置之后普通写入使用的默认TTL，0 为不过期
+int l_shared_table_default_ttl(lua_State* L) {
+    SharedTable* tbl = check_shared_table(L, 1);
+    if (!lua_isnoneornil(L, 2)) {
+        lua_Number ttl = luaL_checknumber(L, 2);
+        luaL_argcheck(L, ttl >= 0, 2, "ttl must be non-negative");
+        if (!shared_table_set_default_ttl(tbl, (double)ttl))
+            return luaL_error(L, "out of memory");
+    }
+    lua_pushnumber(L, (lua_Number)shared_table_get_default_ttl(tbl));
+    return 1;
+}
+
+// xshare.expire(t[, max]) -> 移除的条目数
+// 按过期时间顺序移除已过期的条目，最多 max 个（默认全部）
+int l_shared_table_expire(lua_State* L) {
+    SharedTable* tbl = check_shared_table(L, 1);
+    lua_Integer max = luaL_optinteger(L, 2, -1);
+    size_t n = shared_table_expire(tbl, max < 0 ? (size_t)-1 : (size_t)max);
+    lua_pushinteger(L, (lua_Integer)n);
+    return 1;
+}
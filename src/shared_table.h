@@ -3,19 +3,59 @@
 
 #include <lua.h>
 #include <pthread.h>
+#include <stdint.h>
 #include "GC.h"
 #include "stored_object.h"
 
+// SharedTable 的GC对象种类（排在 StoredType 之后）
+#define SHARED_TABLE_KIND STORED_TYPE_COUNT
+
+// 统计计数器（relaxed 原子计数，启用时才更新）
+typedef struct SharedTableCounters {
+    atomic_size_t reads;          // get / next
+    atomic_size_t writes;         // set / set_metatable
+    atomic_size_t deletes;
+    atomic_size_t readWaits;      // 读锁未能立即获得的次数
+    atomic_size_t writeWaits;
+    atomic_size_t readWaitNs;     // 阻塞等待读锁的累计时间（纳秒）
+    atomic_size_t writeWaitNs;
+    atomic_size_t hits;           // __index 在本表中命中
+    atomic_size_t misses;         // __index 未命中，回退到元表
+    atomic_size_t peakSize;
+    atomic_size_t resizes;        // 键值数组扩容次数
+} SharedTableCounters;
+
+// 统计快照（见 shared_table_get_stats）
+typedef struct SharedTableStats {
+    int enabled;
+    size_t reads, writes, deletes;
+    size_t readWaits, writeWaits;
+    double readWaitTime, writeWaitTime;   // 秒
+    size_t hits, misses;
+    size_t size, peakSize;
+    size_t resizes;
+} SharedTableStats;
+
+typedef struct TableChangeLog TableChangeLog;
+typedef struct TableExpiry TableExpiry;
+
 typedef struct SharedTable {
     GCObject header;
     pthread_rwlock_t lock;
+    atomic_int statsEnabled;      // 本表启用统计
+    SharedTableCounters stats;
     struct {
         StoredObject** keys;
         StoredObject** vals;
+        uint64_t* expires;     // 各条目的过期时间（单调时钟纳秒，0 为不过期），未使用TTL时为NULL
         size_t cap;
         size_t size;
     } entries;
     StoredObject* metatable;   // 元表（可能为NULL或指向另一个SharedTable的StoredObject）
+    atomic_size_t version;     // 每次修改（set/delete/设置元表）后递增
+    TableChangeLog* changes;   // 变更日志，NULL 表示未启用（见 shared_table_enable_changes）
+    size_t changeSeq;          // 最近一次变更的序号，重新启用日志时继续递增
+    TableExpiry* expiry;       // 默认TTL与过期最小堆，首次使用TTL时创建
 } SharedTable;
 
 // 创建新的空SharedTable
@@ -24,30 +64,107 @@ SharedTable* shared_table_create(GC* gc);
 // 设置键值对（增加键和值的引用，若键已存在则替换并释放旧值）
 int shared_table_set(SharedTable* tbl, StoredObject* key, StoredObject* val);
 
-// 获取键对应的值（返回的StoredObject*未增加引用，调用者不应释放，因为值仍属于表）
+// 设置键值对并指定存活时间（秒），ttl <= 0 表示不过期。不带TTL的 shared_table_set 使用表的默认TTL
+int shared_table_set_ttl(SharedTable* tbl, StoredObject* key, StoredObject* val, double ttl);
+
+/* 表的默认TTL（秒），之后 shared_table_set 写入的条目按它过期；0 表示不过期。
+ * 过期的条目立即对 get/next/快照不可见，在写操作时和 shared_table_expire 中按过期时间顺序移除
+ * （最小堆，不扫描全表）。shared_table_size 和统计中的 size 不计已过期的条目 */
+int shared_table_set_default_ttl(SharedTable* tbl, double ttl);
+double shared_table_get_default_ttl(SharedTable* tbl);
+
+// 移除最多 max 个已过期的条目，返回移除的个数
+size_t shared_table_expire(SharedTable* tbl, size_t max);
+
+// 获取键对应的值（返回的StoredObject*已增加引用，调用者用完需 gc_release；解锁后其他线程可能删除该值）
 StoredObject* shared_table_get(SharedTable* tbl, StoredObject* key);
 
 // 删除键（释放键和值的引用）
 void shared_table_delete(SharedTable* tbl, StoredObject* key);
 
-// 返回元素个数
+// 返回元素个数（不含已过期的条目）
 size_t shared_table_size(SharedTable* tbl);
 
 // 返回表的长度（#操作，整数键连续段）
 size_t shared_table_length(SharedTable* tbl);
 
 // 迭代器：获取第一个/下一个键值对。若key为NULL，从头开始；否则从key之后开始。
-// 返回的key和val均为StoredObject*（属于表内部，调用者不应释放）。
+// 返回的key和val均已增加引用，调用者用完需分别 gc_release。
 typedef struct { StoredObject* key; StoredObject* val; } SharedTablePair;
 SharedTablePair shared_table_next(SharedTable* tbl, StoredObject* key);
 
+// 快照：一次加锁取得所有键值对（按表内顺序），键和值都已增加引用，用 shared_table_snapshot_free 释放。
+// 内存不足时返回0
+int shared_table_snapshot(SharedTable* tbl, SharedTablePair** out, size_t* count);
+void shared_table_snapshot_free(SharedTablePair* pairs, size_t count);
+
 // 设置元表（mt应为NULL或指向SharedTable的StoredObject）
 void shared_table_set_metatable(SharedTable* tbl, StoredObject* mt);
 
-// 获取元表（返回的StoredObject*可能为NULL）
+// 获取元表（返回的StoredObject*可能为NULL；非NULL时已增加引用，调用者需 gc_release）
 StoredObject* shared_table_get_metatable(SharedTable* tbl);
 
+// 版本号：每次修改后单调递增（release），读到相同的版本号说明两次读取之间表没有被修改
+static inline size_t shared_table_version(SharedTable* tbl) {
+    return atomic_load_explicit(&tbl->version, memory_order_acquire);
+}
+
+// 为 tbl 开关统计；tbl 为NULL时为所有表开关。计数器只在启用期间累加，关闭后保留
+void shared_table_enable_stats(SharedTable* tbl, int enable);
+
+// 获取统计快照
+void shared_table_get_stats(SharedTable* tbl, SharedTableStats* out);
+
+/* 变更日志：启用后每次 set/delete 追加一条 (序号, 键, 写入的值)，最多保留 capacity 条，写满后覆盖最旧的。
+ * 镜像表的线程记住读到的序号，之后只取这之后的变更，代价与变更数成正比（与表的大小无关）。
+ * 日志持有键和写入的值的引用，被覆盖的旧值在日志中保留到对应的条目被覆盖。
+ * capacity 为0时关闭日志；内存不足时返回0 */
+int shared_table_enable_changes(SharedTable* tbl, size_t capacity);
+
+typedef struct SharedTableChange {
+    size_t seq;
+    StoredObject* key;     // 已增加引用，调用者用完需 gc_release
+    StoredObject* val;     // 这次写入的值（已增加引用），删除或已过期时为NULL
+    int deleted;           // 这次变更是删除
+} SharedTableChange;
+
+/* 读取序号 since 之后的变更，最多 max 条，按序号顺序写入 out，返回条数；*last 为最新的序号。
+ * 日志未启用或 since 之后的变更已被覆盖（需要完整同步）时返回-1。
+ * 返回 max 条时可能还有更多，以最后一条的序号为 since 继续读取 */
+long shared_table_changes(SharedTable* tbl, size_t since, SharedTableChange* out, size_t max, size_t* last);
+
+/* 事务：一次持有多张表的写锁。期间本线程对这些表的操作不再逐次加锁，其他线程的读写都被阻塞。
+ * 列表之外的表不在加锁顺序中，事务内要先用 shared_table_tx_join 加入事务再访问，否则可能死锁 */
+typedef struct SharedTableTx {
+    SharedTable** tables;         // 按地址排序、去重后的表
+    size_t count;
+    SharedTable** joined;         // 事务中途加入的表（只在最外层事务上），已增加引用
+    size_t joinedCount;
+    size_t joinedCap;
+    struct SharedTableTx* outer;  // 外层事务（嵌套时）
+} SharedTableTx;
+
+/* 按地址顺序给 tables 中的表加写锁并登记为当前线程的事务（tables 被原地排序去重，
+ * 事务结束前必须保持有效，调用者保证表在此期间不被回收）。
+ * 嵌套事务只能使用外层事务已持有的表，否则返回0 */
+int shared_table_tx_begin(SharedTableTx* tx, SharedTable** tables, size_t n);
+
+// 结束事务，释放 shared_table_tx_begin 和 shared_table_tx_join 加的锁
+void shared_table_tx_end(SharedTableTx* tx);
+
+/* 把 tbl 加入当前线程的事务：限时等待它的写锁，持有到最外层事务结束。
+ * 不在事务中或已持有时返回1；等待超时（可能与其他事务互相等待）返回0；内存不足返回-1。
+ * Lua 绑定在事务中访问表时自动调用，失败时抛出错误 */
+int shared_table_tx_join(SharedTable* tbl);
+
+// shared_table_tx_join 等待写锁的最长时间（秒，默认0.1，进程级设置）；0 表示只尝试一次不等待
+void shared_table_set_tx_timeout(double seconds);
+double shared_table_get_tx_timeout(void);
+
 // 以下为Lua绑定函数
+
+// 绑定函数所在的堆（第一个 upvalue 为堆句柄或堆指针的闭包），没有时返回默认堆
+GC* shared_table_upvalue_heap(lua_State* L);
 int l_shared_table_new(lua_State* L);
 int l_shared_table_index(lua_State* L);
 int l_shared_table_newindex(lua_State* L);
@@ -61,5 +178,15 @@ int l_shared_table_rawset(lua_State* L);
 int l_shared_table_rawget(lua_State* L);
 int l_shared_table_size(lua_State* L);
 int l_shared_table_gc(lua_State* L);
+int l_shared_table_stats(lua_State* L);
+int l_shared_table_transaction(lua_State* L);
+int l_shared_table_changelog(lua_State* L);
+int l_shared_table_changes(lua_State* L);
+int l_shared_table_cached(lua_State* L);
+int l_shared_table_totable(lua_State* L);
+int l_shared_table_foreach(lua_State* L);
+int l_shared_table_setex(lua_State* L);
+int l_shared_table_default_ttl(lua_State* L);
+int l_shared_table_expire(lua_State* L);
 
 #endif
\ No newline at end of file
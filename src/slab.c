@@ -0,0 +1,235 @@
+#include "slab.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define SLAB_GRANULE 16
+#define SLAB_CLASSES (SLAB_MAX_SIZE / SLAB_GRANULE)
+#define SLAB_BATCH 32                       /* 线程缓存与全局页之间一次交换的块数 */
+#define SLAB_CACHE_LIMIT (SLAB_BATCH * 2)   /* 线程缓存每级最多保留的块数 */
+
+/* 空闲块：链表节点存放在块本身 */
+typedef struct SlabBlock {
+    struct SlabBlock* next;
+} SlabBlock;
+
+/* 页头，位于每个 SLAB_PAGE_SIZE 对齐页的起始处 */
+typedef struct SlabPage {
+    struct SlabPage *prev, *next;   /* 所在级别的“有空闲块”页链表 */
+    SlabBlock* freeList;            /* 页内空闲块 */
+    size_t live;                    /* 已分出的块数（包括线程缓存中的块） */
+    size_t capacity;                /* 页内块总数 */
+    int cls;                        /* 大小级别 */
+    int partial;                    /* 是否在 partial 链表中 */
+} SlabPage;
+
+/* 每级全局状态（受 pool_lock 保护） */
+typedef struct SlabClass {
+    SlabPage* partial;              /* 有空闲块的页 */
+    SlabPage* spare;                /* 保留一个全空页，避免反复申请释放 */
+} SlabClass;
+
+static SlabClass classes[SLAB_CLASSES];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* 线程缓存 */
+typedef struct SlabCache {
+    SlabBlock* head[SLAB_CLASSES];
+    int count[SLAB_CLASSES];
+} SlabCache;
+
+static _Thread_local SlabCache* tls_cache = NULL;
+static pthread_key_t cache_key;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+static inline int size_class(size_t size) {
+    if (size == 0) size = 1;
+    return (int)((size + SLAB_GRANULE - 1) / SLAB_GRANULE) - 1;
+}
+
+static inline size_t class_size(int cls) {
+    return (size_t)(cls + 1) * SLAB_GRANULE;
+}
+
+static inline SlabPage* page_of(void* p) {
+    return (SlabPage*)((uintptr_t)p & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+}
+
+/* 内部：以下函数必须持有 pool_lock */
+static void partial_push(SlabClass* c, SlabPage* page) {
+    page->prev = NULL;
+    page->next = c->partial;
+    if (c->partial) c->partial->prev = page;
+    c->partial = page;
+    page->partial = 1;
+}
+
+static void partial_remove(SlabClass* c, SlabPage* page) {
+    if (page->prev) page->prev->next = page->next;
+    else c->partial = page->next;
+    if (page->next) page->next->prev = page->prev;
+    page->prev = page->next = NULL;
+    page->partial = 0;
+}
+
+static SlabPage* page_new(int cls) {
+    SlabPage* page = (SlabPage*)aligned_alloc(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE);
+    if (!page) return NULL;
+    size_t bsize = class_size(cls);
+    size_t offset = (sizeof(SlabPage) + SLAB_GRANULE - 1) / SLAB_GRANULE * SLAB_GRANULE;
+    page->cls = cls;
+    page->live = 0;
+    page->capacity = (SLAB_PAGE_SIZE - offset) / bsize;
+    page->freeList = NULL;
+    /* 倒序串起，使分配按地址递增 */
+    for (size_t i = page->capacity; i > 0; i--) {
+        SlabBlock* b = (SlabBlock*)((char*)page + offset + (i - 1) * bsize);
+        b->next = page->freeList;
+        page->freeList = b;
+    }
+    page->prev = page->next = NULL;
+    page->partial = 0;
+    return page;
+}
+
+/* 归还一个块到所属页；整页空闲时释放或留作备用 */
+static void page_put(void* p) {
+    SlabPage* page = page_of(p);
+    SlabClass* c = &classes[page->cls];
+    SlabBlock* b = (SlabBlock*)p;
+    b->next = page->freeList;
+    page->freeList = b;
+    page->live--;
+    if (page->live == 0) {
+        if (page->partial) partial_remove(c, page);
+        if (!c->spare) {
+            c->spare = page;
+        } else {
+            free(page);
+        }
+    } else if (!page->partial) {
+        partial_push(c, page);
+    }
+}
+
+/* 从全局页取最多 n 个块，串成链表返回 */
+static SlabBlock* pages_take(int cls, int n, int* got) {
+    SlabClass* c = &classes[cls];
+    SlabBlock* list = NULL;
+    *got = 0;
+    while (*got < n) {
+        SlabPage* page = c->partial;
+        if (!page) {
+            page = c->spare ? c->spare : page_new(cls);
+            c->spare = NULL;
+            if (!page) break;
+            partial_push(c, page);
+        }
+        while (*got < n && page->freeList) {
+            SlabBlock* b = page->freeList;
+            page->freeList = b->next;
+            page->live++;
+            b->next = list;
+            list = b;
+            (*got)++;
+        }
+        if (!page->freeList) partial_remove(c, page);
+    }
+    return list;
+}
+
+/* 线程退出时把缓存中的块全部还给页 */
+static void cache_destroy(void* arg) {
+    SlabCache* cache = (SlabCache*)arg;
+    pthread_mutex_lock(&pool_lock);
+    for (int cls = 0; cls < SLAB_CLASSES; cls++) {
+        SlabBlock* b = cache->head[cls];
+        while (b) {
+            SlabBlock* next = b->next;
+            page_put(b);
+            b = next;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    free(cache);
+}
+
+static void cache_key_init(void) {
+    pthread_key_create(&cache_key, cache_destroy);
+}
+
+static SlabCache* cache_get(void) {
+    if (tls_cache) return tls_cache;
+    pthread_once(&cache_once, cache_key_init);
+    SlabCache* cache = (SlabCache*)calloc(1, sizeof(SlabCache));
+    if (!cache) return NULL;
+    pthread_setspecific(cache_key, cache);
+    tls_cache = cache;
+    return cache;
+}
+
+void* slab_alloc(size_t size) {
+    if (size > SLAB_MAX_SIZE) return malloc(size);
+    int cls = size_class(size);
+    SlabCache* cache = cache_get();
+    if (!cache) {
+        /* 无法建立线程缓存时直接从页中取一块 */
+        int got;
+        pthread_mutex_lock(&pool_lock);
+        SlabBlock* b = pages_take(cls, 1, &got);
+        pthread_mutex_unlock(&pool_lock);
+        return b;
+    }
+
+    if (!cache->head[cls]) {
+        int got;
+        pthread_mutex_lock(&pool_lock);
+        cache->head[cls] = pages_take(cls, SLAB_BATCH, &got);
+        pthread_mutex_unlock(&pool_lock);
+        cache->count[cls] = got;
+        if (!got) return NULL;
+    }
+    SlabBlock* b = cache->head[cls];
+    cache->head[cls] = b->next;
+    cache->count[cls]--;
+    return b;
+}
+
+void slab_free(void* p, size_t size) {
+    if (!p) return;
+    if (size > SLAB_MAX_SIZE) {
+        free(p);
+        return;
+    }
+    int cls = size_class(size);
+    SlabCache* cache = cache_get();
+    if (!cache) {
+        pthread_mutex_lock(&pool_lock);
+        page_put(p);
+        pthread_mutex_unlock(&pool_lock);
+        return;
+    }
+    SlabBlock* b = (SlabBlock*)p;
+    b->next = cache->head[cls];
+    cache->head[cls] = b;
+    if (++cache->count[cls] > SLAB_CACHE_LIMIT) {
+        /* 缓存过多，批量还回一半 */
+        pthread_mutex_lock(&pool_lock);
+        for (int i = 0; i < SLAB_BATCH; i++) {
+            SlabBlock* x = cache->head[cls];
+            cache->head[cls] = x->next;
+            page_put(x);
+        }
+        pthread_mutex_unlock(&pool_lock);
+        cache->count[cls] -= SLAB_BATCH;
+    }
+}
+
+void slab_free_bulk(void** ptrs, size_t n) {
+    if (n == 0) return;
+    pthread_mutex_lock(&pool_lock);
+    for (size_t i = 0; i < n; i++) {
+        page_put(ptrs[i]);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
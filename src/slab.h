@@ -0,0 +1,21 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+/* 小对象分配器：按16字节步长分级，每级从64KB页中切块。
+ * 每个线程有自己的空闲链表，批量与全局页交换；超过 SLAB_MAX_SIZE 的请求直接使用 malloc */
+#define SLAB_MAX_SIZE 512
+#define SLAB_PAGE_SIZE 65536
+
+/* 分配 size 字节，失败返回NULL。内容未初始化 */
+void* slab_alloc(size_t size);
+
+/* 释放 slab_alloc 得到的内存，size 必须与分配时一致 */
+void slab_free(void* p, size_t size);
+
+/* 批量归还小块（每块都必须来自 size <= SLAB_MAX_SIZE 的分配）：
+ * 只加一次锁，直接还给所属页，整页空闲时整页释放。用于GC清除阶段 */
+void slab_free_bulk(void** ptrs, size_t n);
+
+#endif // SLAB_H
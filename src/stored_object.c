@@ -1,8 +1,12 @@
 // stored_object.c
 #include "stored_object.h"
+#include "slab.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "lauxlib.h"  // 用于luaL_loadbuffer
 
 // visited链表节点（用于递归时防止循环）
@@ -43,12 +47,221 @@ static int writer(lua_State* L, const void* p, size_t sz, void* ud) {
     return 0;
 }
 
+// ---------- 函数注册表 ----------
+// 以字节码内容为键，相同原型的函数（例如每个请求存一次的同一个回调）共享一份引用计数的字节码。
+// 注册表是进程级的，不属于任何堆；按哈希分片加锁
+
+#define BYTECODE_SHARDS 16
+#define BYTECODE_BUCKETS 256   // 每个分片的桶数
+
+struct Bytecode {
+    Bytecode* next;            // 桶内链表
+    uint64_t hash;
+    int refs;                  // 受所在分片的锁保护
+    size_t len;
+    char data[];
+};
+
+typedef struct BytecodeShard {
+    pthread_mutex_t lock;
+    Bytecode* buckets[BYTECODE_BUCKETS];
+} BytecodeShard;
+
+static BytecodeShard bytecode_shards[BYTECODE_SHARDS] = {
+#define SHARD_INIT { PTHREAD_MUTEX_INITIALIZER, {0} }
+    SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT,
+    SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT,
+#undef SHARD_INIT
+};
+static atomic_size_t bytecode_count = 0;
+static atomic_size_t bytecode_bytes = 0;
+static atomic_size_t bytecode_refs = 0;
+static atomic_int strip_functions = 0;
+
+void stored_set_strip_functions(int strip) {
+    atomic_store(&strip_functions, strip ? 1 : 0);
+}
+
+int stored_get_strip_functions(void) {
+    return atomic_load(&strip_functions);
+}
+
+void stored_function_stats(size_t* prototypes, size_t* bytes, size_t* references) {
+    if (prototypes) *prototypes = atomic_load(&bytecode_count);
+    if (bytes) *bytes = atomic_load(&bytecode_bytes);
+    if (references) *references = atomic_load(&bytecode_refs);
+}
+
+// FNV-1a
+static uint64_t bytecode_hash(const char* p, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static BytecodeShard* bytecode_shard(uint64_t hash) {
+    return &bytecode_shards[hash % BYTECODE_SHARDS];
+}
+
+static Bytecode** bytecode_bucket(BytecodeShard* shard, uint64_t hash) {
+    return &shard->buckets[(hash / BYTECODE_SHARDS) % BYTECODE_BUCKETS];
+}
+
+// 取得与 data 内容相同的字节码（增加引用），没有则新建。失败返回NULL
+static Bytecode* bytecode_intern(const char* data, size_t len) {
+    uint64_t hash = bytecode_hash(data, len);
+    BytecodeShard* shard = bytecode_shard(hash);
+    Bytecode** bucket = bytecode_bucket(shard, hash);
+    pthread_mutex_lock(&shard->lock);
+    Bytecode* bc = *bucket;
+    while (bc && !(bc->hash == hash && bc->len == len && memcmp(bc->data, data, len) == 0))
+        bc = bc->next;
+    if (bc) {
+        bc->refs++;
+    } else if ((bc = (Bytecode*)malloc(sizeof(Bytecode) + len)) != NULL) {
+        bc->hash = hash;
+        bc->refs = 1;
+        bc->len = len;
+        memcpy(bc->data, data, len);
+        bc->next = *bucket;
+        *bucket = bc;
+        atomic_fetch_add(&bytecode_count, 1);
+        atomic_fetch_add(&bytecode_bytes, len);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (bc) atomic_fetch_add(&bytecode_refs, 1);
+    return bc;
+}
+
+// 释放一个引用，最后一个引用释放时从注册表中移除
+static void bytecode_release(Bytecode* bc) {
+    BytecodeShard* shard = bytecode_shard(bc->hash);
+    atomic_fetch_sub(&bytecode_refs, 1);
+    pthread_mutex_lock(&shard->lock);
+    if (--bc->refs > 0) {
+        pthread_mutex_unlock(&shard->lock);
+        return;
+    }
+    Bytecode** p = bytecode_bucket(shard, bc->hash);
+    while (*p != bc)
+        p = &(*p)->next;
+    *p = bc->next;
+    pthread_mutex_unlock(&shard->lock);
+    atomic_fetch_sub(&bytecode_count, 1);
+    atomic_fetch_sub(&bytecode_bytes, bc->len);
+    free(bc);
+}
+
+const char* STORED_PACK_MT = "XShare.packed";
+
+// ---------- userdata 类型注册表 ----------
+
+static const char* userdata_types[GC_MAX_KINDS];   // 按对象种类索引的元表名
+
+void stored_register_userdata(int kind, const char* metatable) {
+    if (kind >= 0 && kind < GC_MAX_KINDS)
+        userdata_types[kind] = metatable;
+}
+
+// 内部：栈上 idx 处若为已登记类型的 userdata，返回其对象
+static GCObject* test_userdata(lua_State* L, int idx) {
+    for (int kind = 0; kind < GC_MAX_KINDS; kind++) {
+        if (!userdata_types[kind]) continue;
+        GCObject** p = (GCObject**)luaL_testudata(L, idx, userdata_types[kind]);
+        if (p) return *p;
+    }
+    return NULL;
+}
+
+// 遍历强引用，由GC在收集时调用（持有写锁）
+static void stored_trace(GCObject* obj, GCVisitor visit, void* ud) {
+    StoredObject* sobj = (StoredObject*)obj;
+    switch (sobj->type) {
+        case STORED_FUNCTION: {
+            FunctionData* f = sobj->data.func_data;
+            if (f) {
+                for (int i = 0; i < f->upvalue_count; i++) {
+                    if (f->upvalues[i])
+                        visit((GCObject*)f->upvalues[i], ud);
+                }
+            }
+            break;
+        }
+        case STORED_TABLE_COPY: {
+            TableCopy* tc = sobj->data.table_copy;
+            if (tc) {
+                for (size_t i = 0; i < tc->size; i++) {
+                    visit((GCObject*)tc->keys[i], ud);
+                    visit((GCObject*)tc->vals[i], ud);
+                }
+            }
+            break;
+        }
+        case STORED_SHARED_TABLE:
+            visit((GCObject*)sobj->data.shared_table, ud);
+            break;
+        case STORED_USERDATA:
+            visit(sobj->data.userdata_val, ud);
+            break;
+        default:
+            break;
+    }
+}
+
+// 对象附带内存的大小及分类（发布/创建时记入GC统计，析构时按同一公式扣除）
+static size_t payload_size(const StoredObject* sobj, GCMemKind* mem) {
+    switch (sobj->type) {
+        case STORED_STRING:
+            *mem = GC_MEM_STRING;
+            return sobj->data.string_val ? sobj->string_len + 1 : 0;
+        case STORED_FUNCTION: {
+            const FunctionData* f = sobj->data.func_data;
+            *mem = GC_MEM_BYTECODE;
+            // 字节码由函数注册表共享，不计入各个堆（见 stored_function_stats）
+            return f ? sizeof(FunctionData) + f->upvalue_count * sizeof(StoredObject*) : 0;
+        }
+        case STORED_TABLE_COPY: {
+            const TableCopy* tc = sobj->data.table_copy;
+            *mem = GC_MEM_TABLE;
+            return tc ? sizeof(TableCopy) + 2 * tc->capacity * sizeof(StoredObject*) : 0;
+        }
+        default:
+            *mem = GC_MEM_OTHER;
+            return 0;
+    }
+}
+
+// 发布构造完成（或构造失败、等待析构）的函数/表副本。
+// 构造期间子对象由创建时的引用保持为根；发布后改由 trace 遍历，赋值需与收集互斥
+static void stored_publish(StoredObject* sobj, StoredType type, void* data) {
+    GC* gc = sobj->header.gc;
+    gc_mutate_begin(gc);
+    sobj->type = type;
+    if (type == STORED_FUNCTION)
+        sobj->data.func_data = (FunctionData*)data;
+    else
+        sobj->data.table_copy = (TableCopy*)data;
+    gc_mutate_end(gc);
+
+    GCMemKind mem;
+    size_t payload = payload_size(sobj, &mem);
+    gc_set_kind(&sobj->header, type);
+    gc_account(&sobj->header, mem, (ptrdiff_t)payload);
+}
+
 // 对象析构函数，由GC在回收时调用
 static void stored_dtor(GCObject* obj) {
     StoredObject* sobj = (StoredObject*)obj;
+    GCMemKind mem;
+    size_t payload = payload_size(sobj, &mem);
+    if (payload)
+        gc_account(obj, mem, -(ptrdiff_t)payload);
     switch (sobj->type) {
         case STORED_STRING:
-            free(sobj->data.string_val);
+            slab_free(sobj->data.string_val, sobj->string_len + 1);
             break;
         case STORED_FUNCTION: {
             FunctionData* f = sobj->data.func_data;
@@ -58,8 +271,9 @@ static void stored_dtor(GCObject* obj) {
                         gc_release((GCObject*)f->upvalues[i]);
                     }
                 }
-                free(f->bytecode);
-                free(f);
+                if (f->blob)
+                    bytecode_release(f->blob);
+                slab_free(f, sizeof(FunctionData) + f->upvalue_count * sizeof(StoredObject*));
             }
             break;
         }
@@ -72,35 +286,46 @@ static void stored_dtor(GCObject* obj) {
                 }
                 free(tc->keys);
                 free(tc->vals);
-                free(tc);
+                slab_free(tc, sizeof(TableCopy));
             }
             break;
         }
         case STORED_SHARED_TABLE:
             gc_release((GCObject*)sobj->data.shared_table);
             break;
+        case STORED_USERDATA:
+            gc_release(sobj->data.userdata_val);
+            break;
 
         default:
             break;
     }
 }
 
-// 核心递归创建函数
-static StoredObject* stored_create_impl(lua_State* L, int idx, VisitedNode** visited) {
+static StoredObject* wrap_sharedtable(GC* gc, SharedTable* st);
+
+/* 核心递归创建函数（所有对象都分配在 gc 堆中）。失败时返回NULL，不抛出Lua错误：
+ * 递归中已创建的对象只由上层持有，longjmp 会让它们永远留在堆中；错误由顶层的绑定函数抛出 */
+static StoredObject* stored_create_impl(lua_State* L, int idx, GC* gc, VisitedNode** visited) {
     int type = lua_type(L, idx);
-    GC* gc = gc_instance();
+    if (!lua_checkstack(L, 4)) return NULL;   // 嵌套过深
 
     // 先检查visited（只对需要递归的类型有效）
     if (type == LUA_TFUNCTION && !lua_iscfunction(L, idx)) {
         const void* ptr = lua_topointer(L, idx);
         StoredObject* found = find_visited(*visited, ptr);
-        if (found) return found;
+        if (found) {
+            gc_retain((GCObject*)found);   // 返回给调用者的引用
+            return found;
+        }
     }
 
     // 分配对象内存（通过GC）
     StoredObject* sobj = (StoredObject*)gc_create(gc, sizeof(StoredObject) - sizeof(GCObject));
     if (!sobj) return NULL;
     sobj->header.dtor = stored_dtor;
+    sobj->header.trace = stored_trace;
+    sobj->type = STORED_NIL;   // 失败路径会调用析构函数，类型必须先确定
 
     switch (type) {
         case LUA_TNIL:
@@ -126,10 +351,10 @@ static StoredObject* stored_create_impl(lua_State* L, int idx, VisitedNode** vis
             size_t len;
             const char* s = lua_tolstring(L, idx, &len);
             sobj->type = STORED_STRING;
-            sobj->data.string_val = malloc(len + 1);
+            sobj->string_len = len;
+            sobj->data.string_val = slab_alloc(len + 1);
             if (!sobj->data.string_val) goto fail;
             memcpy(sobj->data.string_val, s, len + 1);
-            sobj->string_len = len;
             break;
         }
         case LUA_TLIGHTUSERDATA:
@@ -156,8 +381,10 @@ static StoredObject* stored_create_impl(lua_State* L, int idx, VisitedNode** vis
                 int nup = ar.nups;
 
                 // 分配FunctionData
-                FunctionData* fdata = calloc(1, sizeof(FunctionData) + nup * sizeof(StoredObject*));
+                size_t fsize = sizeof(FunctionData) + nup * sizeof(StoredObject*);
+                FunctionData* fdata = slab_alloc(fsize);
                 if (!fdata) goto fail;
+                memset(fdata, 0, fsize);
                 fdata->upvalue_count = nup;
                 // 获取全局表指针（用于比较）
                 #if LUA_VERSION_NUM >= 502
@@ -171,19 +398,20 @@ static StoredObject* stored_create_impl(lua_State* L, int idx, VisitedNode** vis
                 // 获取字节码
                 Buffer buf = {NULL, 0, 0};
                 lua_pushvalue(L, idx);    // 再次复制函数
-                if (lua_dump(L, writer, &buf, 0) != 0) {
-                    lua_pop(L, 1);
-                    free(buf.data);
-                    free(fdata);
+                int dumped = lua_dump(L, writer, &buf, stored_get_strip_functions()) == 0;
+                lua_pop(L, 1);             // 弹出函数副本
+                Bytecode* blob = dumped ? bytecode_intern(buf.data, buf.size) : NULL;
+                free(buf.data);
+                if (!blob) {
+                    stored_publish(sobj, STORED_FUNCTION, fdata);   // 交给析构函数清理
                     goto fail;
                 }
-                lua_pop(L, 1);             // 弹出函数副本
-                fdata->bytecode = buf.data;
-                fdata->bytecode_len = buf.size;
+                fdata->blob = blob;
+                fdata->bytecode = blob->data;
+                fdata->bytecode_len = blob->len;
 
                 // 获取upvalues
                 lua_pushvalue(L, idx);     // 将函数压栈以便遍历upvalues
-                int created_upvalues = 0;
                 for (int i = 1; i <= nup; i++) {
                     const char* name = lua_getupvalue(L, -1, i);
                     (void)name;
@@ -197,26 +425,17 @@ static StoredObject* stored_create_impl(lua_State* L, int idx, VisitedNode** vis
                         continue;
                     }
 
-                    StoredObject* upval = stored_create_impl(L, -1, visited);
+                    StoredObject* upval = stored_create_impl(L, -1, gc, visited);
                     lua_pop(L, 1);                   // 弹出 upvalue 值
                     if (!upval) {
-                        // 释放已创建的 upvalues
-                        for (int j = 0; j < created_upvalues; j++) {
-                            gc_release((GCObject*)fdata->upvalues[j]);
-                        }
-                        free(fdata->bytecode);
-                        free(fdata);
                         lua_pop(L, 1);                // 弹出函数
+                        stored_publish(sobj, STORED_FUNCTION, fdata);   // 已创建的 upvalues 由析构函数释放
                         goto fail;
                     }
-                    fdata->upvalues[i-1] = upval;
-                    created_upvalues++;
-                    gc_add_reference((GCObject*)sobj, (GCObject*)upval);
+                    fdata->upvalues[i-1] = upval;    // 创建时的引用转移给 sobj
                 }
                 lua_pop(L, 1);               // 弹出函数
-
-                sobj->type = STORED_FUNCTION;
-                sobj->data.func_data = fdata;
+                stored_publish(sobj, STORED_FUNCTION, fdata);
 
                 // 从visited中移除当前节点
                 *visited = cur.next;
@@ -226,92 +445,238 @@ static StoredObject* stored_create_impl(lua_State* L, int idx, VisitedNode** vis
             int abs_idx = lua_absindex(L, idx);   // 获取绝对索引
             const void* ptr = lua_topointer(L, idx);
             StoredObject* found = find_visited(*visited, ptr);
-            if (found) return found;
+            if (found) {
+                gc_release((GCObject*)sobj);
+                gc_retain((GCObject*)found);   // 返回给调用者的引用
+                return found;
+            }
 
-            sobj->type = STORED_TABLE_COPY;
-            sobj->data.table_copy = NULL;               // ① 先置空
             VisitedNode cur = { ptr, sobj, *visited };
             *visited = &cur;
 
-            TableCopy* tc = calloc(1, sizeof(TableCopy));
+            TableCopy* tc = slab_alloc(sizeof(TableCopy));
             if (!tc) goto fail;
+            memset(tc, 0, sizeof(TableCopy));
             tc->capacity = 4;
             tc->keys = malloc(tc->capacity * sizeof(StoredObject*));
             tc->vals = malloc(tc->capacity * sizeof(StoredObject*));
             if (!tc->keys || !tc->vals) {
                 // 即使部分分配失败，也交给析构函数统一释放
-                sobj->data.table_copy = tc;              // ② 尽早赋值
+                stored_publish(sobj, STORED_TABLE_COPY, tc);
                 goto fail;
             }
-            sobj->data.table_copy = tc;                  // ③ 再次赋值（实际已赋过，但安全）
 
             lua_pushnil(L);
             while (lua_next(L, abs_idx)) {
-                StoredObject* key = stored_create_impl(L, -2, visited);
-                StoredObject* val = stored_create_impl(L, -1, visited);
+                StoredObject* key = stored_create_impl(L, -2, gc, visited);
+                StoredObject* val = stored_create_impl(L, -1, gc, visited);
                 lua_pop(L, 1);
                 if (!key || !val) {
                     if (key) gc_release((GCObject*)key);
                     if (val) gc_release((GCObject*)val);
-                    goto fail;                           // ④ 不再手动释放 tc
+                    lua_pop(L, 1);                       // 弹出 lua_next 的键
+                    stored_publish(sobj, STORED_TABLE_COPY, tc);   // 由析构函数清理
+                    goto fail;
                 }
 
                 if (tc->size >= tc->capacity) {
                     size_t newcap = tc->capacity * 2;
                     StoredObject** newkeys = realloc(tc->keys, newcap * sizeof(StoredObject*));
-                    StoredObject** newvals = realloc(tc->vals, newcap * sizeof(StoredObject*));
+                    if (newkeys) tc->keys = newkeys;
+                    StoredObject** newvals = newkeys ? realloc(tc->vals, newcap * sizeof(StoredObject*)) : NULL;
+                    if (newvals) tc->vals = newvals;
                     if (!newkeys || !newvals) {
                         gc_release((GCObject*)key);
                         gc_release((GCObject*)val);
-                        goto fail;                       // ⑤ 直接失败，由析构清理
+                        lua_pop(L, 1);
+                        stored_publish(sobj, STORED_TABLE_COPY, tc);
+                        goto fail;
                     }
-                    tc->keys = newkeys;
-                    tc->vals = newvals;
                     tc->capacity = newcap;
                 }
-                tc->keys[tc->size] = key;
+                tc->keys[tc->size] = key;    // 创建时的引用转移给 sobj
                 tc->vals[tc->size] = val;
                 tc->size++;
-                gc_add_reference((GCObject*)sobj, (GCObject*)key);
-                gc_add_reference((GCObject*)sobj, (GCObject*)val);
             }
+            stored_publish(sobj, STORED_TABLE_COPY, tc);
             *visited = cur.next;
             break;
         }
         case LUA_TUSERDATA: {
+            // 打包句柄：直接引用已经序列化的对象（可以属于其他堆）
+            StoredObject** packed = (StoredObject**)luaL_testudata(L, idx, STORED_PACK_MT);
+            if (packed && *packed) {
+                gc_release((GCObject*)sobj);   // 不使用预先分配的对象
+                gc_retain((GCObject*)*packed);   // 返回给调用者的引用
+                return *packed;
+            }
             // 检查是否为共享表
             SharedTable** stp = (SharedTable**)luaL_testudata(L, idx, SHARED_TABLE_MT);
             if (stp && *stp) {
-                return stored_create_from_sharedtable(*stp);
+                gc_release((GCObject*)sobj);   // 不使用预先分配的对象
+                return wrap_sharedtable(gc, *stp);
+            }
+            GCObject* ref = test_userdata(L, idx);
+            if (ref) {
+                gc_retain(ref);   // sobj 持有引用
+                gc_mutate_begin(gc);
+                sobj->data.userdata_val = ref;
+                sobj->type = STORED_USERDATA;
+                gc_mutate_end(gc);
+                break;
             }
             // 其他userdata不支持
-            luaL_error(L, "cannot store userdata of unknown type");
-            return NULL;
+            goto fail;
         }
         default:
             // 不支持的类型（表、userdata等）
             goto fail;
     }
 
+    /* 标量值没有出边，引用计数降到基线即可立即回收 */
+    if (sobj->type != STORED_FUNCTION && sobj->type != STORED_TABLE_COPY && sobj->type != STORED_USERDATA)
+        sobj->header.flags |= GC_FLAG_LEAF;
+    gc_set_kind(&sobj->header, sobj->type);
+    if (sobj->type == STORED_STRING)
+        gc_account(&sobj->header, GC_MEM_STRING, (ptrdiff_t)(sobj->string_len + 1));
     return sobj;
 
 fail:
-    // 分配失败时，需要释放sobj本身（GC会负责，但尚未加入strongRefs，可直接free）
-    // 但sobj是通过gc_create分配的，已加入GC链表，所以不能直接free。将其refCount设为0？最好调用gc_release？但这里简化：直接返回NULL，让调用者处理。
-    // 更安全的做法是调用gc_release(sobj)来释放，但需要先将其refCount设为1（目前已经是1）。我们直接调用gc_release。
-    gc_release((GCObject*)sobj);  // 减少引用计数，下次GC会回收
+    // sobj 已加入GC链表，不能直接free；释放调用者持有的引用，下次GC会回收
+    gc_release((GCObject*)sobj);
     return NULL;
 }
 
 // 对外接口
 StoredObject* stored_create(lua_State* L, int index) {
+    return stored_create_ex(L, index, gc_instance());
+}
+
+// 内部：追踪时记录耗时超过阈值的传递，参数为顶层对象的附带内存大小（字符串长度、字节码长度等）
+static void trace_transfer(const char* name, StoredObject* obj, uint64_t start) {
+    uint64_t dur = trace_now() - start;
+    if (dur < trace_threshold()) return;
+    GCMemKind mem;
+    size_t bytes = !obj ? 0
+                 : (obj->type == STORED_FUNCTION && obj->data.func_data) ? obj->data.func_data->bytecode_len
+                 : payload_size(obj, &mem);
+    trace_event(name, "transfer", start, dur, "bytes", bytes);
+}
+
+StoredObject* stored_create_ex(lua_State* L, int index, GC* gc) {
     VisitedNode* visited = NULL;
-    return stored_create_impl(L, index, &visited);
+    if (!trace_enabled())
+        return stored_create_impl(L, index, gc, &visited);
+    uint64_t start = trace_now();
+    StoredObject* obj = stored_create_impl(L, index, gc, &visited);
+    trace_transfer("stored.create", obj, start);
+    return obj;
 }
 
-void stored_push_impl(lua_State* L, StoredObject* obj) {
-    GC* gc = gc_instance();
+// ---------- 每个 lua_State 的物化缓存 ----------
+
+/* 注册表[&push_cache_key] 为弱值表：GCObject* -> 已压入过的 userdata，同一对象每次取出得到同一个 userdata
+ * （t.a == t.a），也省去 userdata 分配和引用计数。较长的字符串按地址直接映射到 PUSH_CACHE_SLOTS 个槽，
+ * 槽中的 Lua 字符串存放在同一个表的整数键下；缓存持有这些 StoredObject 的引用，地址不会被复用。
+ * 只缓存默认堆的字符串：独立堆（gc_new）的对象被槽钉住会让堆在释放句柄后一直无法销毁 */
+static char push_cache_key;
+static const char* PUSH_CACHE_MT = "XShare.pushcache";
+
+#define PUSH_CACHE_SLOTS 64             // 2的幂
+#define PUSH_CACHE_MIN_STRING 41        // 更短的字符串由 Lua 驻留，压入时不分配内存
+#define PUSH_CACHE_MAX_STRING 16384     // 更长的不缓存，限制缓存钉住的内存
+
+typedef struct PushCache {
+    StoredObject* strings[PUSH_CACHE_SLOTS];
+} PushCache;
+
+static int push_cache_gc(lua_State* L) {
+    PushCache* pc = (PushCache*)lua_touserdata(L, 1);
+    for (int i = 0; i < PUSH_CACHE_SLOTS; i++) {
+        if (pc->strings[i]) gc_release((GCObject*)pc->strings[i]);
+        pc->strings[i] = NULL;
+    }
+    return 0;
+}
+
+// 内部：压入缓存表（不存在时创建），返回字符串槽
+static PushCache* push_cache(lua_State* L) {
+    if (lua_rawgetp(L, LUA_REGISTRYINDEX, &push_cache_key) == LUA_TTABLE) {
+        lua_rawgetp(L, -1, &push_cache_key);
+        PushCache* pc = (PushCache*)lua_touserdata(L, -1);
+        lua_pop(L, 1);
+        return pc;
+    }
+    lua_pop(L, 1);
+    lua_createtable(L, PUSH_CACHE_SLOTS, 0);
+    PushCache* pc = (PushCache*)lua_newuserdata(L, sizeof(PushCache));
+    memset(pc, 0, sizeof(PushCache));
+    if (luaL_newmetatable(L, PUSH_CACHE_MT)) {
+        lua_pushcfunction(L, push_cache_gc);
+        lua_setfield(L, -2, "__gc");
+    }
+    lua_setmetatable(L, -2);
+    // 表的元表持有槽对象，表中的弱引用因此不会被清除
+    lua_createtable(L, 1, 1);
+    lua_pushliteral(L, "v");
+    lua_setfield(L, -2, "__mode");
+    lua_pushvalue(L, -2);
+    lua_rawseti(L, -2, 1);
+    lua_setmetatable(L, -3);
+    lua_rawsetp(L, -2, &push_cache_key);
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &push_cache_key);
+    return pc;
+}
+
+static void push_string(lua_State* L, StoredObject* obj) {
+    size_t len = obj->string_len;
+    if (len < PUSH_CACHE_MIN_STRING || len > PUSH_CACHE_MAX_STRING || obj->header.gc != gc_instance()) {
+        lua_pushlstring(L, obj->data.string_val, len);
+        return;
+    }
+    PushCache* pc = push_cache(L);
+    int slot = (int)(((uintptr_t)obj >> 4) & (PUSH_CACHE_SLOTS - 1));
+    if (pc->strings[slot] == obj) {
+        lua_rawgeti(L, -1, slot + 1);
+    } else {
+        lua_pushlstring(L, obj->data.string_val, len);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, -3, slot + 1);
+        StoredObject* old = pc->strings[slot];
+        gc_retain((GCObject*)obj);
+        pc->strings[slot] = obj;
+        if (old) gc_release((GCObject*)old);
+    }
+    lua_remove(L, -2);
+}
+
+void stored_push_object(lua_State* L, GCObject* ref, const char* metatable) {
+    push_cache(L);
+    if (lua_rawgetp(L, -1, ref) == LUA_TUSERDATA && *(GCObject**)lua_touserdata(L, -1) == ref) {
+        lua_remove(L, -2);
+        return;
+    }
+    lua_pop(L, 1);
+    GCObject** ud = (GCObject**)lua_newuserdata(L, sizeof(GCObject*));
+    *ud = ref;
+    luaL_setmetatable(L, metatable);
+    gc_retain(ref);   // userdata 持有引用
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, -3, ref);
+    lua_remove(L, -2);
+}
+
+void stored_remember_object(lua_State* L, int idx) {
+    idx = lua_absindex(L, idx);
+    GCObject* ref = *(GCObject**)lua_touserdata(L, idx);
+    push_cache(L);
+    lua_pushvalue(L, idx);
+    lua_rawsetp(L, -2, ref);
+    lua_pop(L, 1);
+}
 
+void stored_push_impl(lua_State* L, StoredObject* obj) {
     if (!obj) {
         lua_pushnil(L);
         return;
@@ -335,7 +700,7 @@ void stored_push_impl(lua_State* L, StoredObject* obj) {
 #endif
             break;
         case STORED_STRING:
-            lua_pushlstring(L, obj->data.string_val, obj->string_len);
+            push_string(L, obj);
             break;
         case STORED_LIGHTUSERDATA:
             lua_pushlightuserdata(L, obj->data.lightuserdata_val);
@@ -375,13 +740,12 @@ void stored_push_impl(lua_State* L, StoredObject* obj) {
             }
             break;
         }
-        case STORED_SHARED_TABLE: {
-            SharedTable* st = obj->data.shared_table;
-            SharedTable** ud = (SharedTable**)lua_newuserdata(L, sizeof(SharedTable*));
-            *ud = st;
-            luaL_getmetatable(L, SHARED_TABLE_MT);
-            lua_setmetatable(L, -2);
-            gc_retain((GCObject*)st);   // userdata 持有引用
+        case STORED_SHARED_TABLE:
+            stored_push_object(L, (GCObject*)obj->data.shared_table, SHARED_TABLE_MT);
+            break;
+        case STORED_USERDATA: {
+            GCObject* ref = obj->data.userdata_val;
+            stored_push_object(L, ref, userdata_types[ref->kind]);
             break;
         }
         default:
@@ -391,10 +755,17 @@ void stored_push_impl(lua_State* L, StoredObject* obj) {
 }
 
 void stored_push(lua_State* L, StoredObject* obj) {
-    GC* gc = gc_instance();
+    if (!obj) {
+        lua_pushnil(L);
+        return;
+    }
+    GC* gc = obj->header.gc;
+    uint64_t start = trace_enabled() ? trace_now() : 0;
     pthread_rwlock_rdlock(&gc->rwlock);
     stored_push_impl(L, obj);
     pthread_rwlock_unlock(&gc->rwlock);
+    if (start)
+        trace_transfer("stored.push", obj, start);
 }
 
 // stored_compare 实现
@@ -440,6 +811,11 @@ int stored_compare(const StoredObject* a, const StoredObject* b) {
             uintptr_t pb = (uintptr_t)b->data.shared_table;
             return (pa < pb) ? -1 : (pa > pb) ? 1 : 0;
         }
+        case STORED_USERDATA: {
+            uintptr_t pa = (uintptr_t)a->data.userdata_val;
+            uintptr_t pb = (uintptr_t)b->data.userdata_val;
+            return (pa < pb) ? -1 : (pa > pb) ? 1 : 0;
+        }
         case STORED_TABLE_COPY: {
             uintptr_t pa = (uintptr_t)a->data.table_copy;
             uintptr_t pb = (uintptr_t)b->data.table_copy;
@@ -449,13 +825,89 @@ int stored_compare(const StoredObject* a, const StoredObject* b) {
     }
 }
 
-StoredObject* stored_create_from_sharedtable(SharedTable* st) {
-    GC* gc = gc_instance();
+static size_t hash_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+size_t stored_hash(const StoredObject* obj) {
+    uint64_t x;
+    switch (obj->type) {
+        case STORED_NIL: x = 0; break;
+        case STORED_BOOLEAN: x = obj->data.boolean_val ? 1 : 0; break;
+        case STORED_INTEGER: x = (uint64_t)obj->data.integer_val; break;
+        case STORED_NUMBER: {
+            lua_Number n = obj->data.number_val;
+            if (n == 0) n = 0;   // -0.0 与 0.0 比较相等
+            x = 0;
+            memcpy(&x, &n, sizeof(n) < sizeof(x) ? sizeof(n) : sizeof(x));
+            break;
+        }
+        case STORED_STRING:
+            return (size_t)bytecode_hash(obj->data.string_val, obj->string_len);
+        case STORED_LIGHTUSERDATA: x = (uintptr_t)obj->data.lightuserdata_val; break;
+        case STORED_CFUNCTION: x = (uintptr_t)(void*)obj->data.cfunction_val; break;
+        case STORED_FUNCTION: x = (uintptr_t)obj->data.func_data; break;
+        case STORED_TABLE_COPY: x = (uintptr_t)obj->data.table_copy; break;
+        case STORED_SHARED_TABLE: x = (uintptr_t)obj->data.shared_table; break;
+        case STORED_USERDATA: x = (uintptr_t)obj->data.userdata_val; break;
+        default: x = 0; break;
+    }
+    return hash_mix(x ^ ((uint64_t)obj->type << 56));
+}
+
+size_t stored_footprint(const StoredObject* obj) {
+    GCMemKind mem;
+    return obj->header.size + payload_size(obj, &mem);
+}
+
+StoredObject* stored_lookup_key(lua_State* L, int index, StoredObject* tmp, GC* gc) {
+    switch (lua_type(L, index)) {
+        case LUA_TBOOLEAN:
+            tmp->type = STORED_BOOLEAN;
+            tmp->data.boolean_val = lua_toboolean(L, index);
+            return tmp;
+        case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+            if (lua_isinteger(L, index)) {
+                tmp->type = STORED_INTEGER;
+                tmp->data.integer_val = lua_tointeger(L, index);
+                return tmp;
+            }
+#endif
+            tmp->type = STORED_NUMBER;
+            tmp->data.number_val = lua_tonumber(L, index);
+            return tmp;
+        case LUA_TSTRING:
+            tmp->type = STORED_STRING;
+            tmp->data.string_val = (char*)lua_tolstring(L, index, &tmp->string_len);
+            return tmp;
+        default:
+            return stored_create_ex(L, index, gc);
+    }
+}
+
+// 在 gc 堆中创建引用 st 的对象（st 可以属于其他堆）
+static StoredObject* wrap_sharedtable(GC* gc, SharedTable* st) {
     StoredObject* sobj = (StoredObject*)gc_create(gc, sizeof(StoredObject) - sizeof(GCObject));
     if (!sobj) return NULL;
     sobj->header.dtor = stored_dtor;
-    sobj->type = STORED_SHARED_TABLE;
+    sobj->header.trace = stored_trace;
+    gc_retain((GCObject*)st);   // StoredObject持有引用
+    gc_mutate_begin(gc);
     sobj->data.shared_table = st;
-    gc_add_reference((GCObject*)sobj, (GCObject*)st);   // StoredObject持有引用
+    sobj->type = STORED_SHARED_TABLE;
+    gc_mutate_end(gc);
+    gc_set_kind(&sobj->header, STORED_SHARED_TABLE);
     return sobj;
-}
\ No newline at end of file
+}
+
+StoredObject* stored_create_from_sharedtable(SharedTable* st) {
+    return wrap_sharedtable(((GCObject*)st)->gc, st);
+}
+
+StoredObject* stored_create_from_sharedtable_ex(SharedTable* st, GC* gc) {
+    return wrap_sharedtable(gc, st);
+}
@@ -7,6 +7,10 @@
 
 extern const char* SHARED_TABLE_MT;
 
+/* 打包句柄（xshare.pack）的元表名：userdata 内容为 StoredObject*，持有引用。
+ * 存储句柄时直接引用其中的对象而不重新序列化，取出时还原为打包时的值 */
+extern const char* STORED_PACK_MT;
+
 typedef enum {
     STORED_NIL,
     STORED_BOOLEAN,
@@ -17,11 +21,16 @@ typedef enum {
     STORED_CFUNCTION,
     STORED_FUNCTION,
     STORED_TABLE_COPY,
-    STORED_SHARED_TABLE
+    STORED_SHARED_TABLE,
+    STORED_USERDATA,      // 已登记的GC对象类型（见 stored_register_userdata）
+    STORED_TYPE_COUNT
 } StoredType;
 
+typedef struct Bytecode Bytecode;
+
 typedef struct FunctionData {
-    char* bytecode;
+    Bytecode* blob;                 // 共享的字节码（见函数注册表）
+    const char* bytecode;           // 指向 blob 的数据
     size_t bytecode_len;
     int upvalue_count;
     unsigned char env_upvalue_pos;  // 0 表示无环境 upvalue
@@ -44,6 +53,7 @@ typedef struct StoredObject {
         FunctionData* func_data;
         TableCopy* table_copy;
         SharedTable* shared_table;   // 存储SharedTable指针
+        GCObject* userdata_val;      // STORED_USERDATA 引用的对象
     } data;
     size_t string_len;    // 仅当type为STRING时有效
 } StoredObject;
@@ -55,16 +65,54 @@ struct TableCopy {
     size_t capacity;
 };
 
-// 从Lua栈上指定索引处创建StoredObject（可能递归）
+// 从Lua栈上指定索引处创建StoredObject（可能递归），分配在默认堆中。
+// 失败（不支持的类型、内存不足、嵌套过深）时返回NULL而不抛出错误，已创建的部分交还给GC
 StoredObject* stored_create(lua_State* L, int index);
 
+// 同上，所有对象（包括递归创建的子对象）分配在 gc 堆中
+StoredObject* stored_create_ex(lua_State* L, int index, GC* gc);
+
 // 将StoredObject推回Lua栈
 void stored_push(lua_State* L, StoredObject* obj);
 
 // 比较两个StoredObject（用于查找键）
 int stored_compare(const StoredObject* a, const StoredObject* b);
 
-// 创建一个包装SharedTable的StoredObject（增加对SharedTable的引用）
+// 与 stored_compare 一致的哈希：比较相等的对象哈希相同
+size_t stored_hash(const StoredObject* obj);
+
+// 对象占用的内存（对象本身加上附带内存，不含引用的子对象）
+size_t stored_footprint(const StoredObject* obj);
+
+// 取得用于查找的键：布尔、数值和字符串直接填入 tmp（字符串指向Lua栈上的内容，只能用于比较和哈希，
+// 不能存储），其他类型在 gc 堆中创建 StoredObject。返回值不是 tmp 时调用者用完需 gc_release
+StoredObject* stored_lookup_key(lua_State* L, int index, StoredObject* tmp, GC* gc);
+
+// 登记一种可以存入共享表的 userdata：内容为 GCObject*，元表名为 metatable，
+// 对象种类为 kind（gc_set_kind）。存储时持有对象的引用，取出时按对象种类创建带同一元表的 userdata。
+// metatable 必须是静态字符串，userdata 的 __gc 负责 gc_release
+void stored_register_userdata(int kind, const char* metatable);
+
+/* 压入对象的 userdata：当前 lua_State 中已有该对象的 userdata 时返回同一个（弱引用缓存），
+ * 否则创建带 metatable 元表的 userdata 并增加引用。同一个共享表或对象每次取出都是同一个 Lua 值 */
+void stored_push_object(lua_State* L, GCObject* ref, const char* metatable);
+
+// 将栈上 idx 处新建的对象 userdata 加入上述缓存（构造函数使用），之后取出该对象得到同一个 userdata
+void stored_remember_object(lua_State* L, int idx);
+
+// 是否在存储Lua函数时去掉调试信息（默认否，进程级设置）。去掉后字节码更小、加载更快，
+// 但错误信息和 debug 库看不到行号与局部变量名
+void stored_set_strip_functions(int strip);
+int stored_get_strip_functions(void);
+
+// 函数注册表统计：相同的字节码只保存一份，prototypes 为不同字节码的份数，
+// bytes 为它们的总大小，references 为引用它们的函数对象数
+void stored_function_stats(size_t* prototypes, size_t* bytes, size_t* references);
+
+// 创建一个包装SharedTable的StoredObject（增加对SharedTable的引用），分配在表所属的堆中
 StoredObject* stored_create_from_sharedtable(SharedTable* st);
 
+// 同上，包装对象分配在 gc 堆中（st 可以属于其他堆）
+StoredObject* stored_create_from_sharedtable_ex(SharedTable* st, GC* gc);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef struct TraceEvent {
+    const char* name;
+    const char* cat;
+    const char* argName;
+    uint64_t ts;
+    uint64_t dur;
+    uint64_t arg;
+} TraceEvent;
+
+/* 每个线程一个环形缓冲区。线程退出后缓冲区保留（事件仍可导出），并由之后的新线程复用 */
+typedef struct TraceRing {
+    struct TraceRing* next;
+    int tid;                        /* 导出时的线程编号 */
+    int owned;                      /* 是否有线程正在使用（受 rings_lock 保护） */
+    atomic_size_t head;             /* 累计写入的事件数，只有所属线程写 */
+    atomic_size_t base;             /* trace_clear 时的 head，导出从这里开始 */
+    TraceEvent events[TRACE_RING_SIZE];
+} TraceRing;
+
+atomic_int trace_on = 0;
+static atomic_uint_fast64_t threshold_ns = TRACE_DEFAULT_THRESHOLD_NS;
+
+static TraceRing* rings = NULL;
+static int ring_count = 0;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local TraceRing* tls_ring = NULL;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static void ring_release(void* p) {
+    pthread_mutex_lock(&rings_lock);
+    ((TraceRing*)p)->owned = 0;
+    pthread_mutex_unlock(&rings_lock);
+}
+
+static void ring_key_init(void) {
+    pthread_key_create(&ring_key, ring_release);
+}
+
+/* 内部：取得当前线程的缓冲区，首次调用时复用空闲缓冲区或新建 */
+static TraceRing* thread_ring(void) {
+    if (tls_ring) return tls_ring;
+    pthread_once(&ring_key_once, ring_key_init);
+    pthread_mutex_lock(&rings_lock);
+    TraceRing* r = rings;
+    while (r && r->owned)
+        r = r->next;
+    if (!r) {
+        r = (TraceRing*)calloc(1, sizeof(TraceRing));
+        if (r) {
+            r->tid = ++ring_count;
+            r->next = rings;
+            rings = r;
+        }
+    }
+    if (r) r->owned = 1;
+    pthread_mutex_unlock(&rings_lock);
+    if (!r) return NULL;
+    tls_ring = r;
+    pthread_setspecific(ring_key, r);
+    return r;
+}
+
+void trace_start(uint64_t threshold) {
+    atomic_store(&threshold_ns, threshold ? threshold : TRACE_DEFAULT_THRESHOLD_NS);
+    atomic_store(&trace_on, 1);
+}
+
+void trace_stop(void) {
+    atomic_store(&trace_on, 0);
+}
+
+uint64_t trace_threshold(void) {
+    return atomic_load_explicit(&threshold_ns, memory_order_relaxed);
+}
+
+uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void trace_event(const char* name, const char* cat, uint64_t start, uint64_t dur,
+                 const char* arg_name, uint64_t arg) {
+    if (!trace_enabled()) return;
+    TraceRing* r = thread_ring();
+    if (!r) return;
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    TraceEvent* e = &r->events[head % TRACE_RING_SIZE];
+    e->name = name;
+    e->cat = cat;
+    e->argName = arg_name;
+    e->ts = start;
+    e->dur = dur;
+    e->arg = arg;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);   // 发布事件
+}
+
+long trace_dump(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+    long n = 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    pthread_mutex_lock(&rings_lock);
+    for (TraceRing* r = rings; r; r = r->next) {
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"xshare-%d\"}}",
+                n ? "," : "", r->tid, r->tid);
+        n++;
+        size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        size_t first = atomic_load(&r->base);
+        if (head - first > TRACE_RING_SIZE)
+            first = head - TRACE_RING_SIZE;
+        for (size_t i = first; i < head; i++) {
+            TraceEvent e = r->events[i % TRACE_RING_SIZE];
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    e.name, e.cat, r->tid, e.ts / 1000.0, e.dur / 1000.0);
+            if (e.argName)
+                fprintf(f, ",\"args\":{\"%s\":%llu}", e.argName, (unsigned long long)e.arg);
+            fputc('}', f);
+            n++;
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+    fprintf(f, "\n]}\n");
+    if (fclose(f) != 0) return -1;
+    return n;
+}
+
+void trace_clear(void) {
+    pthread_mutex_lock(&rings_lock);
+    for (TraceRing* r = rings; r; r = r->next)
+        atomic_store(&r->base, atomic_load(&r->head));
+    pthread_mutex_unlock(&rings_lock);
+}
@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* 事件追踪：每个线程一个定长环形缓冲区，只有所属线程写入（无锁），写满后覆盖最旧的事件。
+ * 记录GC各阶段、超过阈值的加锁等待以及耗时超过阈值的 stored_create/stored_push，
+ * trace_dump 以 Chrome/Perfetto 的 JSON 格式导出，可在 chrome://tracing 或 ui.perfetto.dev 中查看 */
+#define TRACE_RING_SIZE 16384
+#define TRACE_DEFAULT_THRESHOLD_NS 10000   /* 10us */
+
+extern atomic_int trace_on;
+
+/* 是否正在追踪；未启用时各埋点只付出一次 relaxed 读 */
+static inline int trace_enabled(void) {
+    return atomic_load_explicit(&trace_on, memory_order_relaxed);
+}
+
+/* 开始/停止追踪。threshold_ns 为加锁等待和值传递的记录阈值，0 表示使用默认值 */
+void trace_start(uint64_t threshold_ns);
+void trace_stop(void);
+
+/* 记录阈值（纳秒） */
+uint64_t trace_threshold(void);
+
+/* 单调时钟，纳秒 */
+uint64_t trace_now(void);
+
+/* 记录一个持续事件。name、cat、arg_name 必须是静态字符串；arg_name 为NULL时不带参数 */
+void trace_event(const char* name, const char* cat, uint64_t start, uint64_t dur,
+                 const char* arg_name, uint64_t arg);
+
+/* 持续时间超过阈值才记录（用于加锁等待等） */
+static inline void trace_slow(const char* name, const char* cat, uint64_t start, uint64_t dur,
+                              const char* arg_name, uint64_t arg) {
+    if (dur >= trace_threshold())
+        trace_event(name, cat, start, dur, arg_name, arg);
+}
+
+/* 把所有线程缓冲区中的事件写入 path，返回写出的事件数，失败返回-1。
+ * 追踪进行中也可以导出，但正在被覆盖的最旧事件可能丢失 */
+long trace_dump(const char* path);
+
+/* 清空所有缓冲区 */
+void trace_clear(void);
+
+#endif // TRACE_H